@@ -1,89 +1,832 @@
 #include "FFT.hpp"
+#include "FFTCodelets.hpp"
+#include "FFTKernels.hpp"
+#include "Parallel.hpp"
+#include "PlanCache.hpp"
+#include <algorithm>
+#include <atomic>
 
 namespace FFT {
 
-	void SlowDFT(std::vector<std::complex<double>>& data, int is) {
-		int size{ static_cast<int>(data.size()) };
-		auto dataBuf = data;
-		for (int k{ 0 }; k < size; k++) {
-			data[k] = 0;
-			for (int n{ 0 }; n < size; n++) {
-				data[k] += dataBuf[n] * exp(std::complex<double>(0, is * 2 * M_PI * k * n / size));
+	namespace {
+
+		bool isPrime(int value) {
+			for (int d{ 2 }; d * d <= value; d++)
+				if (value % d == 0)
+					return false;
+			return value > 1;
+		}
+
+		// exp(i * angle), computed in double precision.
+		template <typename T>
+		std::complex<T> unitRoot(double angle) {
+			return { static_cast<T>(std::cos(angle)), static_cast<T>(std::sin(angle)) };
+		}
+
+		using Codelets::mul;
+		using Codelets::mulI;
+		using Codelets::radix3Butterfly;
+		using Codelets::radix5Butterfly;
+
+		// Odd radix butterfly using the symmetry of the roots of unity, roots[j] = W_radix^j.
+		template <typename T>
+		inline void oddRadixButterfly(std::complex<T>* x, int radix, const std::complex<T>* roots) {
+			std::complex<T> sums[Plan<T>::MaxDirectRadix / 2];
+			std::complex<T> diffs[Plan<T>::MaxDirectRadix / 2];
+			std::complex<T> outputs[Plan<T>::MaxDirectRadix];
+			int half{ radix / 2 };
+			std::complex<T> total{ x[0] };
+			for (int j{ 1 }; j <= half; j++) {
+				sums[j - 1] = x[j] + x[radix - j];
+				diffs[j - 1] = mulI(x[j] - x[radix - j]);
+				total += sums[j - 1];
+			}
+			for (int t{ 1 }; t <= half; t++) {
+				std::complex<T> re{ x[0] };
+				std::complex<T> im{ 0, 0 };
+				int index{ 0 };
+				for (int j{ 1 }; j <= half; j++) {
+					index += t;
+					if (index >= radix)
+						index -= radix;
+					re += roots[index].real() * sums[j - 1];
+					im += roots[index].imag() * diffs[j - 1];
+				}
+				outputs[t] = re + im;
+				outputs[radix - t] = re - im;
+			}
+			x[0] = total;
+			for (int t{ 1 }; t < radix; t++)
+				x[t] = outputs[t];
+		}
+
+		// Runs a butterfly over all (block, k) groups of a stage with compile-time radix.
+		template <int Radix, typename T, typename Butterfly>
+		void radixPass(std::complex<T>* data, int size, int span, const std::complex<T>* twiddles, Butterfly butterfly) {
+			std::complex<T> x[Radix];
+			for (int block{ 0 }; block < size; block += Radix * span) {
+				for (int k{ 0 }; k < span; k++) {
+					std::complex<T>* base{ data + block + k };
+					x[0] = base[0];
+					for (int j{ 1 }; j < Radix; j++)
+						x[j] = mul(base[j * span], twiddles[(j - 1) * span + k]);
+					butterfly(x);
+					for (int j{ 0 }; j < Radix; j++)
+						base[j * span] = x[j];
+				}
+			}
+		}
+
+		template <typename T>
+		std::complex<T>* getThreadScratch(size_t size) {
+			thread_local std::vector<std::complex<T>> threadScratch;
+			if (threadScratch.size() < size)
+				threadScratch.resize(size);
+			return threadScratch.data();
+		}
+
+		// Rows/columns per worker thread so that each thread gets a worthwhile amount of work.
+		int parallelGrain(int length) {
+			const int minPointsPerThread{ 1 << 16 };
+			return std::max(1, minPointsPerThread / std::max(length, 1));
+		}
+
+		// Largest size for which the codelet stage gathers its input from the unpermuted data. Beyond it the
+		// strided reads miss the cache on every point, and the permutation is done up front by swaps instead.
+		const int maxGatherSize{ 1 << 16 };
+
+		// Sequences gathered per tile: 8 data points fill two 64 byte cache lines of each row.
+		const int columnBlock{ 8 };
+
+		// Padding of tile rows, so that power of two sizes do not map every tile row to the same cache sets.
+		const int tilePadding{ 4 };
+
+		// Buffer size tiledPass() needs for a plan: the tile, then scratch for the plan.
+		template <typename T>
+		size_t tileBufferSize(const Plan<T>& plan) {
+			return columnBlock * (static_cast<size_t>(plan.Size()) + tilePadding) + plan.ScratchSize();
+		}
+
+		// Transform sequences [begin, end) with the plan, whose size should equal the sequence length.
+		// Sequences are processed in tiles of columnBlock: the tile is transposed into contiguous rows,
+		// each row is transformed and the tile is transposed back. When the points of neighbouring
+		// sequences are adjacent in memory, as in the columns of an image, every cache line read is
+		// used whole instead of one data point per line with a sequence by sequence gather.
+		// point(sequence, n) is a reference to point n of a sequence.
+		// Optional twiddles[n] multiply output n of every sequence on the way back.
+		template <typename T, typename Point>
+		void tiledPass(const Plan<T>& plan, int begin, int end, Point point, std::complex<T>* buffer, const std::complex<T>* twiddles = nullptr) {
+			const int length{ plan.Size() };
+			const size_t tileStride{ static_cast<size_t>(length) + tilePadding };
+			std::complex<T>* tile{ buffer };
+			std::complex<T>* scratch{ buffer + columnBlock * tileStride };
+
+			for (int first{ begin }; first < end; first += columnBlock) {
+				int tileWidth{ std::min(columnBlock, end - first) };
+
+				for (int n{ 0 }; n < length; n++)
+					for (int c{ 0 }; c < tileWidth; c++)
+						tile[c * tileStride + n] = point(first + c, n);
+
+				for (int c{ 0 }; c < tileWidth; c++)
+					plan.Execute(tile + c * tileStride, scratch);
+
+				if (twiddles) {
+					for (int n{ 0 }; n < length; n++)
+						for (int c{ 0 }; c < tileWidth; c++)
+							point(first + c, n) = mul(tile[c * tileStride + n], twiddles[n]);
+				}
+				else {
+					for (int n{ 0 }; n < length; n++)
+						for (int c{ 0 }; c < tileWidth; c++)
+							point(first + c, n) = tile[c * tileStride + n];
+				}
+			}
+		}
+
+		// Column bytes from which columnPass() is four-step. Whole column tiles are then 512 KiB, where four steps measured faster.
+		std::atomic<size_t> fourStepThreshold{ size_t{ 64 } << 10 };
+
+		// Smallest factor of length that is at least sqrt(length), or length if it is prime.
+		int fourStepFactor(int length) {
+			int factor{ static_cast<int>(std::sqrt(static_cast<double>(length))) };
+			while (factor * factor < length)
+				factor++;
+			while (length % factor != 0)
+				factor++;
+			return factor;
+		}
+
+		// Row i of a matrix starts at rows[i]. The 2D transforms work on these for every storage layout.
+		template <typename T>
+		using RowPointers = std::vector<T*>;
+
+		template <typename T>
+		RowPointers<T> rowPointers(std::vector<std::vector<T>>& data) {
+			RowPointers<T> rows(data.size());
+			for (size_t i{ 0 }; i < data.size(); i++)
+				rows[i] = data[i].data();
+			return rows;
+		}
+
+		template <typename T>
+		RowPointers<T> rowPointers(T* data, int height, ptrdiff_t stride) {
+			RowPointers<T> rows(height);
+			for (int i{ 0 }; i < height; i++)
+				rows[i] = data + i * stride;
+			return rows;
+		}
+
+		// Reorder the rows so that row r holds former row source[r]. Only the row vectors are moved.
+		template <typename T>
+		void reorderRows(std::vector<std::vector<T>>& data, const std::vector<int>& source) {
+			std::vector<std::vector<T>> rows(data.size());
+			for (size_t r{ 0 }; r < rows.size(); r++)
+				rows[r] = std::move(data[source[r]]);
+			data.swap(rows);
+		}
+
+		// Reorder strided rows by following the cycles of the permutation, with one row of extra memory.
+		template <typename T>
+		void reorderRows(T* data, ptrdiff_t stride, int width, const std::vector<int>& source) {
+			std::vector<bool> moved(source.size());
+			std::vector<T> saved(width);
+			for (int start{ 0 }; start < static_cast<int>(source.size()); start++) {
+				if (moved[start] || source[start] == start)
+					continue;
+				std::copy(data + start * stride, data + start * stride + width, saved.begin());
+				for (int r{ start };;) {
+					int from{ source[r] };
+					moved[r] = true;
+					if (from == start) {
+						std::copy(saved.begin(), saved.end(), data + r * stride);
+						break;
+					}
+					std::copy(data + from * stride, data + from * stride + width, data + r * stride);
+					r = from;
+				}
+			}
+		}
+
+		// Transform every column of the rows with a plan of the row count per tile of columnBlock columns.
+		template <typename T>
+		void directColumnPass(const RowPointers<std::complex<T>>& rows, int width, int is) {
+			int height{ static_cast<int>(rows.size()) };
+			int tiles{ (width + columnBlock - 1) / columnBlock };
+			auto plan{ GetPlan<T>(height, is) };
+
+			ParallelFor(tiles, std::max(1, parallelGrain(height) / columnBlock), [&rows, &plan, width](int begin, int end) {
+				std::complex<T>* buffer{ getThreadScratch<T>(tileBufferSize(*plan)) };
+				auto point{ [&rows](int column, int row) -> std::complex<T>& { return rows[row][column]; } };
+				tiledPass(*plan, begin * columnBlock, std::min(end * columnBlock, width), point, buffer);
+			});
+		}
+
+		// Four-step column transform of length N = N1 * N2, for columns too long for a tile to stay in cache.
+		// Row n1 * N2 + n2 holds point n1 of the interleaved sequence n2.
+		// 1. Transform the N2 interleaved sequences of length N1 and multiply output k1 of sequence n2 by W_N^(k1 * n2).
+		// 2. Transform the N1 blocks of N2 consecutive rows. Row k1 * N2 + k2 then holds output k1 + N1 * k2.
+		// 3. Transpose the rows into output order by reorder(source), see reorderRows().
+		// Tiles of both passes are columnBlock by about sqrt(N) points.
+		template <typename T, typename Reorder>
+		void fourStepColumnPass(const RowPointers<std::complex<T>>& rows, int width, int is, int length1, Reorder reorder) {
+			int height{ static_cast<int>(rows.size()) };
+			int length2{ height / length1 };
+			int tiles{ (width + columnBlock - 1) / columnBlock };
+			auto plan1{ GetPlan<T>(length1, is) };
+			auto plan2{ GetPlan<T>(length2, is) };
+
+			// twiddles[n2 * N1 + k1] = W_N^(k1 * n2), with k1 * n2 < N.
+			std::vector<std::complex<T>> twiddles(height);
+			for (int n2{ 0 }; n2 < length2; n2++)
+				for (int k1{ 0 }; k1 < length1; k1++)
+					twiddles[n2 * length1 + k1] = unitRoot<T>(is * 2 * M_PI * k1 * n2 / height);
+
+			// Work items are (sequence, tile) pairs, tiles of the same sequence are consecutive.
+			auto pass{ [&rows, width, tiles](const Plan<T>& plan, int sequences, int rowStride, int sequenceStride, const std::complex<T>* sequenceTwiddles) {
+				ParallelFor(sequences * tiles, std::max(1, parallelGrain(plan.Size()) / columnBlock), [&](int begin, int end) {
+					std::complex<T>* buffer{ getThreadScratch<T>(tileBufferSize(plan)) };
+					for (int item{ begin }; item < end;) {
+						int sequence{ item / tiles };
+						int tileEnd{ std::min(end, (sequence + 1) * tiles) };
+						int firstRow{ sequence * sequenceStride };
+						auto point{ [&rows, firstRow, rowStride](int column, int n) -> std::complex<T>& { return rows[firstRow + n * rowStride][column]; } };
+						tiledPass(plan, (item - sequence * tiles) * columnBlock, std::min((tileEnd - sequence * tiles) * columnBlock, width), point, buffer,
+								  sequenceTwiddles ? sequenceTwiddles + static_cast<size_t>(sequence) * plan.Size() : nullptr);
+						item = tileEnd;
+					}
+				});
+			} };
+
+			pass(*plan1, length2, length2, 1, twiddles.data());
+			pass(*plan2, length1, 1, length2, nullptr);
+
+			std::vector<int> source(height);
+			for (int k1{ 0 }; k1 < length1; k1++)
+				for (int k2{ 0 }; k2 < length2; k2++)
+					source[k1 + length1 * k2] = k1 * length2 + k2;
+			reorder(source);
+		}
+
+		// Transform every column of the rows. Four-step from GetFourStepThreshold() on, if the row count has a usable split.
+		// reorder(source) moves the rows of the matrix behind the row pointers, see reorderRows().
+		template <typename T, typename Reorder>
+		void columnPass(const RowPointers<std::complex<T>>& rows, int width, int is, Reorder reorder) {
+			int height{ static_cast<int>(rows.size()) };
+			size_t threshold{ fourStepThreshold };
+			if (threshold > 0 && height * sizeof(std::complex<T>) >= threshold) {
+				int length1{ fourStepFactor(height) };
+				// A lopsided split leaves the longer pass with tiles nearly as large as the direct pass.
+				if (static_cast<long long>(length1) * length1 <= 4LL * height) {
+					fourStepColumnPass(rows, width, is, length1, reorder);
+					return;
+				}
 			}
+			directColumnPass(rows, width, is);
 		}
+
+		template <typename T, typename Reorder>
+		void transform2D(const RowPointers<std::complex<T>>& rows, int width, int is, Reorder reorder) {
+			int height{ static_cast<int>(rows.size()) };
+			auto rowPlan{ GetPlan<T>(width, is) };
+
+			ParallelFor(height, parallelGrain(width), [&rows, &rowPlan](int begin, int end) {
+				for (int i{ begin }; i < end; i++) {
+					rowPlan->Execute(rows[i]);
+				}
+			});
+
+			columnPass(rows, width, is, reorder);
+		}
+
+		template <typename T, typename Reorder>
+		void realTransform2D(const RowPointers<const T>& data, int width, const RowPointers<std::complex<T>>& spectrum, int is, Reorder reorder) {
+			int height{ static_cast<int>(data.size()) };
+			auto rowPlan{ GetRealPlan<T>(width, is) };
+
+			ParallelFor(height, parallelGrain(width), [&data, &spectrum, &rowPlan](int begin, int end) {
+				for (int i{ begin }; i < end; i++) {
+					rowPlan->Forward(data[i], spectrum[i]);
+				}
+			});
+
+			columnPass(spectrum, rowPlan->SpectrumSize(), is, reorder);
+		}
+
+		// Row pass of the inverse real transforms, which follows the column pass.
+		template <typename T>
+		void inverseRealRows(const RowPointers<std::complex<T>>& spectrum, int width, const RowPointers<T>& data, int is) {
+			int height{ static_cast<int>(spectrum.size()) };
+			auto rowPlan{ GetRealPlan<T>(width, -is) };
+
+			ParallelFor(height, parallelGrain(width), [&spectrum, &data, &rowPlan](int begin, int end) {
+				for (int i{ begin }; i < end; i++) {
+					rowPlan->Inverse(spectrum[i], data[i]);
+				}
+			});
+		}
+
 	}
 
-	void fft(std::vector<std::complex<double>>& data, int is) {
-		int size{ static_cast<int>(data.size()) };
-		if (size == 1) return;
-		if (size % 2 == 1) {
-			SlowDFT(data, is);
+	template <typename T>
+	Plan<T>::Plan(int size, int is) : m_size{ size }, m_is{ is } {
+		if (m_size <= 1)
+			return;
+
+		if (m_size > MaxDirectRadix && isPrime(m_size)) {
+			// Bluestein: the transform is a convolution with a chirp, done by power of two FFTs.
+			int convSize{ 1 };
+			while (convSize < 2 * m_size - 1)
+				convSize *= 2;
+			m_convPlan = std::make_shared<const Plan>(convSize, -1);
+			m_chirp.resize(m_size);
+			// Spectrum of the conjugate chirp, computed in double precision and scaled by 1/convSize.
+			std::vector<std::complex<double>> filter(convSize, { 0, 0 });
+			for (long long n{ 0 }; n < m_size; n++) {
+				// n^2 mod 2*size keeps the angle small and accurate.
+				double angle{ is * M_PI * static_cast<double>((n * n) % (2LL * m_size)) / m_size };
+				m_chirp[n] = unitRoot<T>(angle);
+				filter[n] = std::polar(1.0, -angle);
+				if (n > 0)
+					filter[convSize - n] = filter[n];
+			}
+			Plan<double>(convSize, -1).Execute(filter.data());
+			m_chirpSpectrum.resize(convSize);
+			for (int k{ 0 }; k < convSize; k++)
+				m_chirpSpectrum[k] = { static_cast<T>(filter[k].real() / convSize), static_cast<T>(filter[k].imag() / convSize) };
+			m_scratchSize = convSize + m_convPlan->ScratchSize();
 			return;
 		}
 
-		std::vector<std::complex<double>> dataEven(size / 2);
-		std::vector<std::complex<double>> dataOdd(size / 2);
-		for (int i{ 0 }; i < size / 2; i++) {
-			dataEven[i] = data[2 * i];
-			dataOdd[i] = data[2 * i + 1];
+		// The innermost stage is a codelet for the largest part of the size made of factors 2, 3 and 5
+		// up to Codelets::MaxSize. It keeps an even number of factors 2 for the vectorized radix 4 stages.
+		int rest{ m_size };
+		int twos{ 0 };
+		while ((rest >> twos) % 2 == 0)
+			twos++;
+		int codeletSize{ 1 << (twos <= 5 ? twos : 4 + twos % 2) };
+		for (int factor : { 3, 5 })
+			while (rest % (codeletSize * factor) == 0 && codeletSize * factor <= Codelets::MaxSize)
+				codeletSize *= factor;
+		if (codeletSize == 1)
+			codeletSize = 0;
+		else
+			rest /= codeletSize;
+
+		// Factor the rest. Stages run innermost first: the codelet, large odd radices, then 7/5/3, then 2, then 4.
+		std::vector<int> radices;
+		while (rest % 4 == 0) {
+			radices.push_back(4);
+			rest /= 4;
+		}
+		if (rest % 2 == 0) {
+			radices.push_back(2);
+			rest /= 2;
+		}
+		for (int factor{ 3 }; rest > 1; factor += 2) {
+			if (factor * factor > rest)
+				factor = rest;
+			while (rest % factor == 0) {
+				radices.push_back(factor);
+				rest /= factor;
+			}
 		}
+		std::reverse(radices.begin(), radices.end());
 
-		fft(dataEven, is);
-		fft(dataOdd, is);
+		int span{ 1 };
+		if (codeletSize > 0) {
+			m_stages.push_back({ codeletSize, span, 0, 0, nullptr, Codelets::Get<T>(codeletSize, is) });
+			span = codeletSize;
+		}
+		for (int radix : radices) {
+			Stage stage{ radix, span, m_twiddles.size(), m_roots.size(), nullptr, nullptr };
+			for (int j{ 1 }; j < radix; j++) {
+				for (int k{ 0 }; k < span; k++) {
+					long long phase{ (static_cast<long long>(j) * k) % (radix * span) };
+					m_twiddles.push_back(unitRoot<T>(is * 2 * M_PI * static_cast<double>(phase) / (radix * span)));
+				}
+			}
+			if (radix > MaxDirectRadix) {
+				stage.subPlan = std::make_shared<const Plan>(radix, is);
+				m_scratchSize = std::max(m_scratchSize, radix + stage.subPlan->ScratchSize());
+			}
+			else if (radix > 5) {
+				for (int j{ 0 }; j < radix; j++)
+					m_roots.push_back(unitRoot<T>(is * 2 * M_PI * j / radix));
+			}
+			m_stages.push_back(std::move(stage));
+			span *= radix;
+		}
 
-		for (int k{ 0 }; k < size / 2; k++) {
-			std::complex<double> oddTermExp = exp(std::complex<double>(0, is * 2 * M_PI * k / size));
-			data[k] = dataEven[k] + oddTermExp * dataOdd[k];
-			data[k + size / 2] = dataEven[k] - oddTermExp * dataOdd[k];
+		// Decimation in time: with the outermost radix r, subsequence x[j], x[j + r], ...
+		// is transformed in block j. Position p therefore takes its input from the index
+		// whose mixed radix digits are those of p in reverse order.
+		std::vector<int> perm(m_size);
+		for (int p{ 0 }; p < m_size; p++) {
+			int rem{ p };
+			int blockSize{ m_size };
+			int source{ 0 };
+			int multiplier{ 1 };
+			for (auto stage{ m_stages.rbegin() }; stage != m_stages.rend(); ++stage) {
+				blockSize /= stage->radix;
+				source += (rem / blockSize) * multiplier;
+				rem %= blockSize;
+				multiplier *= stage->radix;
+			}
+			perm[p] = source;
+		}
+
+		if (codeletSize > 0 && m_size <= maxGatherSize) {
+			// The codelet reads its input straight from the data, so only the block order is needed.
+			m_blockSources.resize(m_size / codeletSize);
+			for (int block{ 0 }; block < m_size / codeletSize; block++)
+				m_blockSources[block] = perm[block * codeletSize];
+			m_scratchSize += m_size;
+			return;
+		}
+
+		// Decompose the permutation into cycles and record each cycle as a chain of swaps.
+		std::vector<bool> visited(m_size, false);
+		for (int start{ 0 }; start < m_size; start++) {
+			if (visited[start])
+				continue;
+			visited[start] = true;
+			int current{ start };
+			while (!visited[perm[current]]) {
+				m_swaps.emplace_back(current, perm[current]);
+				current = perm[current];
+				visited[current] = true;
+			}
 		}
 	}
 
-	void fft2D(std::vector<std::vector<std::complex<double>>>& data, int is) {
-		int sizeDim1{ static_cast<int>(data.size()) };
-		int sizeDim2{ static_cast<int>(data[0].size()) };
-		std::vector<std::complex<double>> dataRow;
-		std::vector<std::complex<double>> dataCol;
+	template <typename T>
+	void Plan<T>::Execute(std::complex<T>* data, std::complex<T>* scratch) const {
+		if (m_size <= 1)
+			return;
+
+		if (scratch == nullptr && m_scratchSize > 0)
+			scratch = getThreadScratch<T>(m_scratchSize);
 
-		for (int i{ 0 }; i < sizeDim1; i++) {
-			dataRow.clear();
-			dataRow = data[i];
-			fft(dataRow, is);
-			data[i] = dataRow;
+		if (m_convPlan) {
+			executeBluestein(data, scratch);
+			return;
+		}
+
+		if (!m_blockSources.empty()) {
+			// The codelet stage gathers each block from the unpermuted data into scratch,
+			// the other stages run there and the result is copied back.
+			const Stage& first{ m_stages.front() };
+			const int blocks{ static_cast<int>(m_blockSources.size()) };
+			for (int block{ 0 }; block < blocks; block++)
+				first.codelet(data + m_blockSources[block], blocks, scratch + block * first.radix);
+			for (size_t s{ 1 }; s < m_stages.size(); s++)
+				executeStage(m_stages[s], scratch, scratch + m_size);
+			std::copy(scratch, scratch + m_size, data);
+			return;
+		}
+
+		for (auto& [a, b] : m_swaps)
+			std::swap(data[a], data[b]);
+
+		for (auto& stage : m_stages)
+			executeStage(stage, data, scratch);
+	}
+
+	template <typename T>
+	void Plan<T>::Execute(std::vector<std::complex<T>>& data) const {
+		Execute(data.data());
+	}
+
+	template <typename T>
+	size_t Plan<T>::MemorySize() const {
+		size_t bytes{ sizeof(*this) };
+		bytes += m_stages.capacity() * sizeof(Stage);
+		bytes += m_swaps.capacity() * sizeof(m_swaps[0]);
+		bytes += m_blockSources.capacity() * sizeof(int);
+		bytes += (m_twiddles.capacity() + m_roots.capacity() + m_chirp.capacity() + m_chirpSpectrum.capacity()) * sizeof(std::complex<T>);
+		for (auto& stage : m_stages) {
+			if (stage.subPlan)
+				bytes += stage.subPlan->MemorySize();
+		}
+		if (m_convPlan)
+			bytes += m_convPlan->MemorySize();
+		return bytes;
+	}
+
+	template <typename T>
+	size_t Plan<T>::BatchScratchSize() const {
+		return tileBufferSize(*this);
+	}
+
+	template <typename T>
+	void Plan<T>::ExecuteBatch(std::complex<T>* data, ptrdiff_t stride, int batch, ptrdiff_t distance, std::complex<T>* scratch) const {
+		if (m_size <= 1 || batch <= 0)
+			return;
+
+		if (scratch == nullptr)
+			scratch = getThreadScratch<T>(BatchScratchSize());
+
+		if (stride == 1) {
+			for (int b{ 0 }; b < batch; b++)
+				Execute(data + b * distance, scratch);
+			return;
+		}
+
+		auto point{ [data, stride, distance](int sequence, int n) -> std::complex<T>& { return data[sequence * distance + n * stride]; } };
+		tiledPass(*this, 0, batch, point, scratch);
+	}
+
+	template <typename T>
+	void Plan<T>::executeStage(const Stage& stage, std::complex<T>* data, std::complex<T>* scratch) const {
+		const int radix{ stage.radix };
+		const int span{ stage.span };
+		const std::complex<T>* twiddles{ m_twiddles.data() + stage.twiddleOffset };
+		const std::complex<T>* roots{ m_roots.data() + stage.rootOffset };
+		const T is{ static_cast<T>(m_is) };
+
+		if (stage.codelet) {
+			// Innermost stage on permuted data: each block of radix points is one transform in natural order.
+			std::complex<T> x[Codelets::MaxSize];
+			for (int block{ 0 }; block < m_size; block += radix) {
+				std::copy(data + block, data + block + radix, x);
+				stage.codelet(x, 1, data + block);
+			}
+			return;
+		}
+
+		if (radix > MaxDirectRadix) {
+			for (int block{ 0 }; block < m_size; block += radix * span) {
+				for (int k{ 0 }; k < span; k++) {
+					std::complex<T>* base{ data + block + k };
+					scratch[0] = base[0];
+					for (int j{ 1 }; j < radix; j++)
+						scratch[j] = mul(base[j * span], twiddles[(j - 1) * span + k]);
+					stage.subPlan->Execute(scratch, scratch + radix);
+					for (int j{ 0 }; j < radix; j++)
+						base[j * span] = scratch[j];
+				}
+			}
+			return;
+		}
+
+		switch (radix) {
+			case 2: Kernels::Active<T>().radix2(data, m_size, span, twiddles); break;
+			case 3: radixPass<3>(data, m_size, span, twiddles, [is](std::complex<T>* x) { radix3Butterfly(x, is); }); break;
+			case 4: Kernels::Active<T>().radix4(data, m_size, span, twiddles, m_is); break;
+			case 5: radixPass<5>(data, m_size, span, twiddles, [is](std::complex<T>* x) { radix5Butterfly(x, is); }); break;
+			case 7: radixPass<7>(data, m_size, span, twiddles, [roots](std::complex<T>* x) { oddRadixButterfly(x, 7, roots); }); break;
+			default: {
+				std::complex<T> x[MaxDirectRadix];
+				for (int block{ 0 }; block < m_size; block += radix * span) {
+					for (int k{ 0 }; k < span; k++) {
+						std::complex<T>* base{ data + block + k };
+						x[0] = base[0];
+						for (int j{ 1 }; j < radix; j++)
+							x[j] = mul(base[j * span], twiddles[(j - 1) * span + k]);
+						oddRadixButterfly(x, radix, roots);
+						for (int j{ 0 }; j < radix; j++)
+							base[j * span] = x[j];
+					}
+				}
+				break;
+			}
+		}
+	}
+
+	template <typename T>
+	void Plan<T>::executeBluestein(std::complex<T>* data, std::complex<T>* scratch) const {
+		const int convSize{ m_convPlan->Size() };
+		for (int n{ 0 }; n < m_size; n++)
+			scratch[n] = data[n] * m_chirp[n];
+		std::fill(scratch + m_size, scratch + convSize, std::complex<T>{ 0, 0 });
+
+		m_convPlan->Execute(scratch, scratch + convSize);
+		// Inverse transform of the product as conj(DFT(conj(product))).
+		for (int k{ 0 }; k < convSize; k++)
+			scratch[k] = std::conj(scratch[k] * m_chirpSpectrum[k]);
+		m_convPlan->Execute(scratch, scratch + convSize);
+
+		for (int k{ 0 }; k < m_size; k++)
+			data[k] = m_chirp[k] * std::conj(scratch[k]);
+	}
+
+	template <typename T>
+	RealPlan<T>::RealPlan(int size, int is)
+		: m_size{ size },
+		  m_is{ is },
+		  m_forwardPlan(size % 2 == 0 ? size / 2 : size, is),
+		  m_inversePlan(size % 2 == 0 ? size / 2 : size, -is) {
+		if (m_size % 2 == 0) {
+			m_twiddles.resize(m_size / 2);
+			for (int k{ 0 }; k < m_size / 2; k++)
+				m_twiddles[k] = unitRoot<T>(is * 2 * M_PI * k / m_size);
+			m_scratchSize = std::max(m_forwardPlan.ScratchSize(), m_inversePlan.ScratchSize());
+		}
+		else {
+			m_scratchSize = m_size + std::max(m_forwardPlan.ScratchSize(), m_inversePlan.ScratchSize());
+		}
+	}
+
+	template <typename T>
+	size_t RealPlan<T>::MemorySize() const {
+		return sizeof(*this) - 2 * sizeof(Plan<T>) + m_forwardPlan.MemorySize() + m_inversePlan.MemorySize() +
+			m_twiddles.capacity() * sizeof(std::complex<T>);
+	}
+
+	template <typename T>
+	void RealPlan<T>::Forward(const T* data, std::complex<T>* spectrum, std::complex<T>* scratch) const {
+		if (scratch == nullptr && m_scratchSize > 0)
+			scratch = getThreadScratch<T>(m_scratchSize);
+
+		if (m_size % 2 == 1) {
+			for (int n{ 0 }; n < m_size; n++)
+				scratch[n] = data[n];
+			m_forwardPlan.Execute(scratch, scratch + m_size);
+			std::copy(scratch, scratch + SpectrumSize(), spectrum);
+			return;
+		}
+
+		// Pack even/odd samples as real/imaginary parts and transform at half size.
+		const int half{ m_size / 2 };
+		for (int n{ 0 }; n < half; n++)
+			spectrum[n] = { data[2 * n], data[2 * n + 1] };
+		m_forwardPlan.Execute(spectrum, scratch);
+
+		// Split into spectra of even (E) and odd (O) samples: X[k] = E[k] + W^k * O[k].
+		std::complex<T> z0{ spectrum[0] };
+		spectrum[0] = { z0.real() + z0.imag(), 0 };
+		spectrum[half] = { z0.real() - z0.imag(), 0 };
+		for (int k{ 1 }; k <= half / 2; k++) {
+			int m{ half - k };
+			std::complex<T> zk{ spectrum[k] };
+			std::complex<T> zm{ std::conj(spectrum[m]) };
+			std::complex<T> even{ static_cast<T>(0.5) * (zk + zm) };
+			std::complex<T> odd{ std::complex<T>(0, -0.5) * (zk - zm) };
+			spectrum[k] = even + mul(m_twiddles[k], odd);
+			spectrum[m] = std::conj(even) + mul(m_twiddles[m], std::conj(odd));
 		}
+	}
+
+	template <typename T>
+	void RealPlan<T>::Inverse(const std::complex<T>* spectrum, T* data, std::complex<T>* scratch) const {
+		if (scratch == nullptr && m_scratchSize > 0)
+			scratch = getThreadScratch<T>(m_scratchSize);
 
-		for (int j{ 0 }; j < sizeDim2; j++) {
-			dataCol.resize(sizeDim1);
-			for (int k{ 0 }; k < sizeDim1; k++) {
-				dataCol[k] = data[k][j];
+		if (m_size % 2 == 1) {
+			scratch[0] = spectrum[0];
+			for (int k{ 1 }; k < SpectrumSize(); k++) {
+				scratch[k] = spectrum[k];
+				scratch[m_size - k] = std::conj(spectrum[k]);
 			}
-			fft(dataCol, is);
+			m_inversePlan.Execute(scratch, scratch + m_size);
+			for (int n{ 0 }; n < m_size; n++)
+				data[n] = scratch[n].real();
+			return;
+		}
 
-			for (int k{ 0 }; k < sizeDim1; k++) {
-				data[k][j] = dataCol[k];
+		// Rebuild the packed half size spectrum Z[k] = E[k] + i * O[k] (times 2), in the output buffer.
+		const int half{ m_size / 2 };
+		std::complex<T>* packed{ reinterpret_cast<std::complex<T>*>(data) };
+		for (int k{ 0 }; k < half; k++) {
+			std::complex<T> xk{ spectrum[k] };
+			std::complex<T> xm{ std::conj(spectrum[half - k]) };
+			std::complex<T> even{ xk + xm };
+			std::complex<T> odd{ mul(xk - xm, std::conj(m_twiddles[k])) };
+			packed[k] = even + std::complex<T>(-odd.imag(), odd.real());
+		}
+		m_inversePlan.Execute(packed, scratch);
+	}
+
+	template <typename T>
+	void SlowDFT(std::vector<std::complex<T>>& data, int is) {
+		int size{ static_cast<int>(data.size()) };
+		auto dataBuf = data;
+		for (int k{ 0 }; k < size; k++) {
+			data[k] = 0;
+			for (int n{ 0 }; n < size; n++) {
+				data[k] += dataBuf[n] * unitRoot<T>(is * 2 * M_PI * k * n / size);
 			}
 		}
 	}
 
+	void SetFourStepThreshold(size_t bytes) {
+		fourStepThreshold = bytes;
+	}
+
+	size_t GetFourStepThreshold() {
+		return fourStepThreshold;
+	}
+
+	template <typename T>
+	void fft(std::vector<std::complex<T>>& data, int is) {
+		GetPlan<T>(static_cast<int>(data.size()), is)->Execute(data);
+	}
+
+	template <typename T>
+	void fftBatch(std::complex<T>* data, int length, ptrdiff_t stride, int batch, ptrdiff_t distance, int is) {
+		auto plan{ GetPlan<T>(length, is) };
+		ParallelFor(batch, parallelGrain(length), [data, stride, distance, &plan](int begin, int end) {
+			plan->ExecuteBatch(data + begin * distance, stride, end - begin, distance);
+		});
+	}
+
+	template <typename T>
+	void fft2D(std::vector<std::vector<std::complex<T>>>& data, int is) {
+		transform2D(rowPointers(data), static_cast<int>(data[0].size()), is,
+					[&data](const std::vector<int>& source) { reorderRows(data, source); });
+	}
+
+	template <typename T>
+	void fft2D(std::complex<T>* data, int height, int width, ptrdiff_t stride, int is) {
+		transform2D(rowPointers(data, height, stride), width, is,
+					[data, width, stride](const std::vector<int>& source) { reorderRows(data, stride, width, source); });
+	}
+
+	template <typename T>
+	void rfft2D(const std::vector<std::vector<T>>& data, std::vector<std::vector<std::complex<T>>>& spectrum, int is) {
+		int sizeDim1{ static_cast<int>(data.size()) };
+		int sizeDim2{ static_cast<int>(data[0].size()) };
+		spectrum.assign(sizeDim1, std::vector<std::complex<T>>(sizeDim2 / 2 + 1));
+		RowPointers<const T> dataRows(sizeDim1);
+		for (int i{ 0 }; i < sizeDim1; i++)
+			dataRows[i] = data[i].data();
+		realTransform2D(dataRows, sizeDim2, rowPointers(spectrum), is,
+						[&spectrum](const std::vector<int>& source) { reorderRows(spectrum, source); });
+	}
+
+	template <typename T>
+	void rfft2D(const T* data, int height, int width, ptrdiff_t stride, std::complex<T>* spectrum, ptrdiff_t spectrumStride, int is) {
+		int spectrumWidth{ width / 2 + 1 };
+		realTransform2D(rowPointers(data, height, stride), width, rowPointers(spectrum, height, spectrumStride), is,
+						[spectrum, spectrumWidth, spectrumStride](const std::vector<int>& source) { reorderRows(spectrum, spectrumStride, spectrumWidth, source); });
+	}
+
+	template <typename T>
+	void irfft2D(std::vector<std::vector<std::complex<T>>>& spectrum, int width, std::vector<std::vector<T>>& data, int is) {
+		int sizeDim1{ static_cast<int>(spectrum.size()) };
+		columnPass(rowPointers(spectrum), static_cast<int>(spectrum[0].size()), is,
+				   [&spectrum](const std::vector<int>& source) { reorderRows(spectrum, source); });
+
+		data.assign(sizeDim1, std::vector<T>(width));
+		inverseRealRows(rowPointers(spectrum), width, rowPointers(data), is);
+	}
+
+	template <typename T>
+	void irfft2D(std::complex<T>* spectrum, ptrdiff_t spectrumStride, int height, int width, T* data, ptrdiff_t stride, int is) {
+		int spectrumWidth{ width / 2 + 1 };
+		auto spectrumRows{ rowPointers(spectrum, height, spectrumStride) };
+		columnPass(spectrumRows, spectrumWidth, is,
+				   [spectrum, spectrumWidth, spectrumStride](const std::vector<int>& source) { reorderRows(spectrum, spectrumStride, spectrumWidth, source); });
+		inverseRealRows(spectrumRows, width, rowPointers(data, height, stride), is);
+	}
+
 	void ComputeSpectrogram(const std::vector<std::complex<double>>& data, std::vector<std::vector<double>>& spectrogram, int windowSize, int windowOverlap) {
 		if (windowSize <= windowOverlap)
 			return;
-		std::vector<std::complex<double>> window(windowSize, { 0,0 });
 		int size{ static_cast<int>(data.size()) };
-		int windowStartPos{ 0 };
-		while (windowStartPos < size) {
-			for (int i{ 0 }; i < windowSize; i++) {
-				if (windowStartPos + i < size)
-					window[i] = data[windowStartPos + i];
-				else
-					window[i] = { 0,0 };
-			}
-			fft(window, -1);
-			spectrogram.push_back(std::vector<double>(0));
-			for (auto& val : window)
-				spectrogram.back().push_back(sqrt(val.real() * val.real() + val.imag() * val.imag()));
-			windowStartPos += windowSize - windowOverlap;
+		int hop{ windowSize - windowOverlap };
+		int windows{ (size + hop - 1) / hop };
+
+		// Gather the zero padded windows into one buffer and transform them all in one batch.
+		std::vector<std::complex<double>> frames(static_cast<size_t>(windows) * windowSize, { 0,0 });
+		for (int w{ 0 }; w < windows; w++) {
+			int windowStartPos{ w * hop };
+			int count{ std::min(windowSize, size - windowStartPos) };
+			std::copy(data.begin() + windowStartPos, data.begin() + windowStartPos + count, frames.begin() + static_cast<size_t>(w) * windowSize);
 		}
+		fftBatch(frames.data(), windowSize, 1, windows, windowSize, -1);
 
+		for (int w{ 0 }; w < windows; w++) {
+			spectrogram.push_back(std::vector<double>(windowSize));
+			const std::complex<double>* window{ frames.data() + static_cast<size_t>(w) * windowSize };
+			for (int i{ 0 }; i < windowSize; i++)
+				spectrogram.back()[i] = sqrt(window[i].real() * window[i].real() + window[i].imag() * window[i].imag());
+		}
 	}
 
-}
\ No newline at end of file
+	template class Plan<float>;
+	template class Plan<double>;
+	template class RealPlan<float>;
+	template class RealPlan<double>;
+
+	template void SlowDFT(std::vector<std::complex<float>>&, int);
+	template void SlowDFT(std::vector<std::complex<double>>&, int);
+	template void fft(std::vector<std::complex<float>>&, int);
+	template void fft(std::vector<std::complex<double>>&, int);
+	template void fftBatch(std::complex<float>*, int, ptrdiff_t, int, ptrdiff_t, int);
+	template void fftBatch(std::complex<double>*, int, ptrdiff_t, int, ptrdiff_t, int);
+	template void fft2D(std::vector<std::vector<std::complex<float>>>&, int);
+	template void fft2D(std::vector<std::vector<std::complex<double>>>&, int);
+	template void rfft2D(const std::vector<std::vector<float>>&, std::vector<std::vector<std::complex<float>>>&, int);
+	template void rfft2D(const std::vector<std::vector<double>>&, std::vector<std::vector<std::complex<double>>>&, int);
+	template void irfft2D(std::vector<std::vector<std::complex<float>>>&, int, std::vector<std::vector<float>>&, int);
+	template void irfft2D(std::vector<std::vector<std::complex<double>>>&, int, std::vector<std::vector<double>>&, int);
+	template void fft2D(std::complex<float>*, int, int, ptrdiff_t, int);
+	template void fft2D(std::complex<double>*, int, int, ptrdiff_t, int);
+	template void rfft2D(const float*, int, int, ptrdiff_t, std::complex<float>*, ptrdiff_t, int);
+	template void rfft2D(const double*, int, int, ptrdiff_t, std::complex<double>*, ptrdiff_t, int);
+	template void irfft2D(std::complex<float>*, ptrdiff_t, int, int, float*, ptrdiff_t, int);
+	template void irfft2D(std::complex<double>*, ptrdiff_t, int, int, double*, ptrdiff_t, int);
+
+}
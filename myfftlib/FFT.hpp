@@ -2,34 +2,267 @@
 #define FFT_HPP
 
 #include <complex>
+#include <cstddef>
+#include <memory>
+#include <utility>
 #include <vector>
-#define M_PI           3.14159265358979323846 
+#define M_PI           3.14159265358979323846
 
 namespace FFT {
 
+	/**
+	 * Precomputed state for repeated transforms of one size and direction.
+	 *
+	 * The size is factored into a straight-line codelet for its 2/3/5 part up to size 64
+	 * (the innermost stage), then radix 4/2/3/5/7 stages (plus direct stages for other
+	 * small primes), prime sizes above MaxDirectRadix are computed by Bluestein's
+	 * chirp-z algorithm, so every size runs in O(n log n). The plan holds the input
+	 * permutation and the twiddle factors of every stage, so that Execute() runs an
+	 * iterative in-place transform without calling exp() or allocating memory per transform.
+	 *
+	 * Instantiated for T = float and T = double. Tables are computed in double precision either way.
+	 */
+	template <typename T = double>
+	class Plan {
+	public:
+		// Largest prime factor handled by a direct butterfly, larger ones go through Bluestein.
+		static constexpr int MaxDirectRadix{ 31 };
+
+		/**
+		 * @size Transform size.
+		 * @is Direction of transform. Should be -1/1 (forward/inverse).
+		 */
+		Plan(int size, int is);
+
+		int Size() const { return m_size; }
+		int Direction() const { return m_is; }
+
+		/**
+		 * Number of data points of scratch memory Execute() needs.
+		 */
+		size_t ScratchSize() const { return m_scratchSize; }
+
+		/**
+		 * Approximate memory held by the plan and its tables, in bytes.
+		 */
+		size_t MemorySize() const;
+
+		/**
+		 * Transform data in place.
+		 *
+		 * @data In/out parameter. Should point to Size() data points. Out goes transformed data.
+		 * @scratch Buffer of ScratchSize() data points. If null, a per-thread buffer is used.
+		 */
+		void Execute(std::complex<T>* data, std::complex<T>* scratch = nullptr) const;
+		void Execute(std::vector<std::complex<T>>& data) const;
+
+		/**
+		 * Number of data points of scratch memory ExecuteBatch() needs.
+		 */
+		size_t BatchScratchSize() const;
+
+		/**
+		 * Transform batch sequences of Size() points in place, without copying them out.
+		 * Point n of sequence b is data[b * distance + n * stride]. Strided sequences are
+		 * gathered a few at a time into scratch, so columns of a row-major image are cheap.
+		 *
+		 * @data In/out parameter. Out goes transformed data.
+		 * @stride Distance between the points of a sequence.
+		 * @batch Number of sequences.
+		 * @distance Distance between the first points of consecutive sequences.
+		 * @scratch Buffer of BatchScratchSize() data points. If null, a per-thread buffer is used.
+		 */
+		void ExecuteBatch(std::complex<T>* data, ptrdiff_t stride, int batch, ptrdiff_t distance, std::complex<T>* scratch = nullptr) const;
+
+	private:
+		struct Stage {
+			int radix{};
+			int span{};                   // Distance between butterfly inputs (product of previous radices).
+			size_t twiddleOffset{};       // (radix - 1) * span twiddles, W_{radix*span}^{j*k} at [(j - 1) * span + k].
+			size_t rootOffset{};          // radix roots of unity W_radix^j, for direct odd radix stages.
+			std::shared_ptr<const Plan> subPlan{}; // Bluestein plan for a large prime radix.
+			// Straight-line transform of the whole radix, for the innermost stage (see FFTCodelets.hpp).
+			void (*codelet)(const std::complex<T>* in, size_t stride, std::complex<T>* out){};
+		};
+
+		void executeStage(const Stage& stage, std::complex<T>* data, std::complex<T>* scratch) const;
+		void executeBluestein(std::complex<T>* data, std::complex<T>* scratch) const;
+
+		int m_size{};
+		int m_is{};
+		size_t m_scratchSize{};
+		std::vector<Stage> m_stages{};
+		// Transpositions that put the input into the order expected by the butterfly stages.
+		std::vector<std::pair<int, int>> m_swaps{};
+		// Instead of swaps for smaller sizes with a codelet stage: first input point of each codelet block,
+		// the other points follow at stride Size()/radix. The codelet gathers them itself.
+		std::vector<int> m_blockSources{};
+		std::vector<std::complex<T>> m_twiddles{};
+		std::vector<std::complex<T>> m_roots{};
+		// Bluestein: chirp exp(is*pi*i*n^2/size), and spectrum of its conjugate scaled by 1/convolution size.
+		std::shared_ptr<const Plan> m_convPlan{};
+		std::vector<std::complex<T>> m_chirp{};
+		std::vector<std::complex<T>> m_chirpSpectrum{};
+	};
+
+	/**
+	 * Precomputed state for transforms of real data of one size.
+	 *
+	 * Forward() maps Size() real points to the Size()/2 + 1 non-redundant points of
+	 * the Hermitian spectrum, Inverse() maps such a half spectrum back to real data.
+	 * Even sizes run as a complex transform of half the size. Instantiated for T = float and T = double.
+	 */
+	template <typename T = double>
+	class RealPlan {
+	public:
+		/**
+		 * @size Transform size.
+		 * @is Direction of the forward transform. Should be -1/1. Inverse() uses -is.
+		 */
+		RealPlan(int size, int is);
+
+		int Size() const { return m_size; }
+		int Direction() const { return m_is; }
+		int SpectrumSize() const { return m_size / 2 + 1; }
+		size_t ScratchSize() const { return m_scratchSize; }
+		size_t MemorySize() const;
+
+		/**
+		 * @data In parameter. Should point to Size() real data points.
+		 * @spectrum Out parameter. Should point to SpectrumSize() data points.
+		 * @scratch Buffer of ScratchSize() data points. If null, a per-thread buffer is used.
+		 */
+		void Forward(const T* data, std::complex<T>* spectrum, std::complex<T>* scratch = nullptr) const;
+
+		/**
+		 * Unnormalized inverse, the result is Size() times the original data.
+		 *
+		 * @spectrum In parameter. Should point to SpectrumSize() data points.
+		 * @data Out parameter. Should point to Size() real data points. Must not overlap spectrum.
+		 * @scratch Buffer of ScratchSize() data points. If null, a per-thread buffer is used.
+		 */
+		void Inverse(const std::complex<T>* spectrum, T* data, std::complex<T>* scratch = nullptr) const;
+
+	private:
+		int m_size{};
+		int m_is{};
+		size_t m_scratchSize{};
+		// Even sizes: half size transforms and exp(is*2*pi*i*k/size), k < size/2.
+		// Odd sizes: full size transforms.
+		Plan<T> m_forwardPlan;
+		Plan<T> m_inversePlan;
+		std::vector<std::complex<T>> m_twiddles{};
+	};
+
 	/**
 	 * Slow DFT implementation for arbitrary data size.
-	 * 
+	 *
 	 * @data In/out parameter. Should contain data points to transform. Out goes transformed data.
 	 * @is Direction of transform. Should be -1/1 (forward/inverse).
 	 */
-	void SlowDFT(std::vector<std::complex<double>>& data, int is);
+	template <typename T>
+	void SlowDFT(std::vector<std::complex<T>>& data, int is);
 
 	/**
-	 * FFT implementation for data size 2^x.
+	 * FFT implementation for arbitrary data size. Executes the cached Plan of the size (see PlanCache.hpp).
 	 *
 	 * @data In/out parameter. Should contain data points to transform. Out goes transformed data.
 	 * @is Direction of transform. Should be -1/1 (forward/inverse).
 	 */
-	void fft(std::vector<std::complex<double>>& data, int is);
+	template <typename T>
+	void fft(std::vector<std::complex<T>>& data, int is);
+
+	/**
+	 * Batched FFT of sequences in one buffer, see Plan::ExecuteBatch(). Uses the cached Plan of
+	 * the length and splits the batch across GetThreadCount() worker threads.
+	 *
+	 * @data In/out parameter. Point n of sequence b is data[b * distance + n * stride]. Out goes transformed data.
+	 * @length Number of points of each sequence.
+	 * @stride Distance between the points of a sequence.
+	 * @batch Number of sequences.
+	 * @distance Distance between the first points of consecutive sequences.
+	 * @is Direction of transform. Should be -1/1 (forward/inverse).
+	 */
+	template <typename T>
+	void fftBatch(std::complex<T>* data, int length, ptrdiff_t stride, int batch, ptrdiff_t distance, int is);
+
+	/**
+	 * Set the column size from which the 2D transforms split column transforms in four steps. A column
+	 * of length N = N1 * N2 is transformed as N2 interleaved sequences of N1 rows, multiplied by
+	 * twiddles, then as N1 blocks of N2 consecutive rows, and the rows are transposed back into order.
+	 * Both passes work on tiles of about sqrt(N) rows, which stay in cache where the tiles of a whole
+	 * column do not, so huge images are transformed at close to memory bandwidth.
+	 * Row counts without a factor split near sqrt(N), like primes, always use whole columns.
+	 *
+	 * @bytes Threshold on rows times the size of a complex data point, 64 KiB by default. 0 disables the four-step transform.
+	 */
+	void SetFourStepThreshold(size_t bytes);
+
+	/**
+	 * Column size in bytes from which the 2D transforms split column transforms in four steps, 0 if disabled.
+	 */
+	size_t GetFourStepThreshold();
 
 	/**
-	 * 2D FFT implementation for data size 2^x.
+	 * 2D FFT implementation for arbitrary data size. One cached Plan is shared by all rows, another by all columns.
+	 * Rows, then columns, are split across GetThreadCount() worker threads (see Parallel.hpp).
 	 *
 	 * @data In/out parameter. Should contain data points to transform. Out goes transformed data.
 	 * @is Direction of transform. Should be -1/1 (forward/inverse).
 	 */
-	void fft2D(std::vector<std::vector<std::complex<double>>>& data, int is);
+	template <typename T>
+	void fft2D(std::vector<std::vector<std::complex<T>>>& data, int is);
+
+	/**
+	 * 2D FFT of a matrix in one buffer, rows stride points apart.
+	 *
+	 * @data In/out parameter. Point (i, j) is data[i * stride + j]. Out goes transformed data.
+	 * @height Number of rows.
+	 * @width Number of columns.
+	 * @stride Distance between the first points of consecutive rows, at least width.
+	 * @is Direction of transform. Should be -1/1 (forward/inverse).
+	 */
+	template <typename T>
+	void fft2D(std::complex<T>* data, int height, int width, ptrdiff_t stride, int is);
+
+	/**
+	 * 2D FFT of real data. Only the non-redundant half of the spectrum is computed.
+	 *
+	 * @data In parameter. Should contain real data points to transform.
+	 * @spectrum Out parameter for columns 0..width/2 of the spectrum.
+	 * @is Direction of transform. Should be -1/1 (forward/inverse).
+	 */
+	template <typename T>
+	void rfft2D(const std::vector<std::vector<T>>& data, std::vector<std::vector<std::complex<T>>>& spectrum, int is);
+
+	/**
+	 * rfft2D of a matrix in one buffer.
+	 *
+	 * @data In parameter. Real point (i, j) is data[i * stride + j].
+	 * @spectrum Out parameter for height rows of width/2+1 points, spectrumStride points apart.
+	 */
+	template <typename T>
+	void rfft2D(const T* data, int height, int width, ptrdiff_t stride, std::complex<T>* spectrum, ptrdiff_t spectrumStride, int is);
+
+	/**
+	 * Inverse of rfft2D. Unnormalized, the result is width*height times the original data.
+	 *
+	 * @spectrum In parameter. Should contain columns 0..width/2 of a Hermitian spectrum. Used as workspace.
+	 * @width Width of the real data.
+	 * @data Out parameter for real data.
+	 * @is Direction of transform. Should be -1/1 (forward/inverse).
+	 */
+	template <typename T>
+	void irfft2D(std::vector<std::vector<std::complex<T>>>& spectrum, int width, std::vector<std::vector<T>>& data, int is);
+
+	/**
+	 * irfft2D of a matrix in one buffer.
+	 *
+	 * @spectrum In parameter. Should contain height rows of width/2+1 points, spectrumStride points apart. Used as workspace.
+	 * @data Out parameter for height rows of width real points, stride points apart.
+	 */
+	template <typename T>
+	void irfft2D(std::complex<T>* spectrum, ptrdiff_t spectrumStride, int height, int width, T* data, ptrdiff_t stride, int is);
 
 	/**
 	 * Compute spectrogram for given data.
@@ -40,9 +273,14 @@ namespace FFT {
 	 * @windowOver Window overlap.
 	 */
 	void ComputeSpectrogram(const std::vector<std::complex<double>>& data,
-							std::vector<std::vector<double>>& spectrogram, 
-							int windowSize, 
+							std::vector<std::vector<double>>& spectrogram,
+							int windowSize,
 							int windowOverlap);
+
+	extern template class Plan<float>;
+	extern template class Plan<double>;
+	extern template class RealPlan<float>;
+	extern template class RealPlan<double>;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,386 @@
+// fft_bench: speed and accuracy sweep of myfftlib, written as JSON to stdout.
+//
+// Usage: fft_bench [--quick] [--min-time <seconds>] [--threads <count>] [--scaling]
+//
+// Every case reports the best time per transform over repeated batches, GFLOP/s by the usual
+// 5 N log2(N) estimate (2.5 N log2(N) for real input), and heap allocations per transform.
+// Sizes up to maxCheckedSize are checked against SlowDFT. The exit code is 1 if any check fails.
+// --scaling adds the time of one large fft2D at 1, 2, 4, ... threads up to the hardware thread count.
+
+#include "FFT.hpp"
+#include "FFTKernels.hpp"
+#include "Parallel.hpp"
+#include "PlanCache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	std::atomic<uint64_t> allocationCount{ 0 };
+	std::atomic<uint64_t> allocatedBytes{ 0 };
+
+}
+
+// Count every heap allocation of the process, including those of the library and its worker threads.
+void* operator new(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* pointer{ std::malloc(size == 0 ? 1 : size) })
+		return pointer;
+	throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+namespace {
+
+	// Largest 1D transform size checked against SlowDFT, 2D transforms up to 16 times as many points.
+	// SlowDFT is O(N^2) per sequence.
+	const int maxCheckedSize{ 4096 };
+
+	struct Options {
+		bool quick{ false };
+		double minTime{ 0.2 };   // Seconds of timed batches per case.
+		int threads{ 0 };
+		bool scaling{ false };
+	};
+
+	struct ScalingPoint {
+		int threads{};
+		double ns{};
+	};
+
+	struct Result {
+		std::string transform{};
+		std::string precision{};
+		int height{};            // 1 for 1D transforms.
+		int width{};
+		double ns{};
+		double gflops{};
+		double allocations{};
+		double allocatedBytes{};
+		double error{ -1 };      // Relative RMS error against SlowDFT, -1 if not checked.
+		bool passed{ true };
+	};
+
+	template <typename T>
+	const char* precisionName() {
+		return sizeof(T) == sizeof(float) ? "float" : "double";
+	}
+
+	// Largest relative RMS error accepted for transforms of the length. SlowDFT computes the angle
+	// of every term from k * n, its own error grows with the length and dominates in double.
+	template <typename T>
+	double tolerance(int length) {
+		return sizeof(T) == sizeof(float) ? 1e-5 : 1e-12 * std::max(1.0, length / 256.0);
+	}
+
+	// Transforms per timed batch. Each unnormalized transform grows the data by about sqrt(N),
+	// batches restart from the input before the values leave the range of T.
+	template <typename T>
+	int batchLength(double points) {
+		double headroom{ sizeof(T) == sizeof(float) ? 15.0 : 100.0 };
+		return std::max(1, static_cast<int>(headroom / (0.5 * std::log10(std::max(points, 2.0)))));
+	}
+
+	// Best seconds per call of run() over batches of at most maxBatch calls, reset() before every batch.
+	// Also the heap allocations and bytes per call.
+	template <typename Reset, typename Run>
+	void measure(const Options& options, int maxBatch, Reset reset, Run run, Result& result) {
+		using Clock = std::chrono::steady_clock;
+		reset();
+		run(); // Builds and caches the plans.
+
+		double best{ 1e300 };
+		double total{ 0 };
+		uint64_t calls{ 0 };
+		uint64_t allocations{ 0 };
+		uint64_t bytes{ 0 };
+		int batch{ 1 };
+		while (total < options.minTime || calls < 3) {
+			reset();
+			uint64_t allocationsBefore{ allocationCount.load() };
+			uint64_t bytesBefore{ allocatedBytes.load() };
+			auto start{ Clock::now() };
+			for (int i{ 0 }; i < batch; i++)
+				run();
+			double seconds{ std::chrono::duration<double>(Clock::now() - start).count() };
+			allocations += allocationCount.load() - allocationsBefore;
+			bytes += allocatedBytes.load() - bytesBefore;
+			best = std::min(best, seconds / batch);
+			total += seconds;
+			calls += batch;
+			// Batches of about a millisecond, so that clock overhead does not count.
+			if (seconds < 1e-3 && batch < maxBatch)
+				batch = std::min(maxBatch, batch * 2);
+		}
+		result.ns = best * 1e9;
+		result.allocations = static_cast<double>(allocations) / calls;
+		result.allocatedBytes = static_cast<double>(bytes) / calls;
+	}
+
+	template <typename T>
+	std::vector<std::complex<T>> randomData(size_t size, unsigned seed) {
+		std::mt19937 generator{ seed };
+		std::uniform_real_distribution<double> distribution{ -1, 1 };
+		std::vector<std::complex<T>> data(size);
+		for (auto& point : data)
+			point = { static_cast<T>(distribution(generator)), static_cast<T>(distribution(generator)) };
+		return data;
+	}
+
+	template <typename T>
+	double relativeRmsError(const std::vector<std::complex<T>>& result, const std::vector<std::complex<double>>& reference) {
+		double errorEnergy{ 0 };
+		double energy{ 0 };
+		for (size_t i{ 0 }; i < reference.size(); i++) {
+			errorEnergy += std::norm(static_cast<std::complex<double>>(result[i]) - reference[i]);
+			energy += std::norm(reference[i]);
+		}
+		return energy > 0 ? std::sqrt(errorEnergy / energy) : std::sqrt(errorEnergy);
+	}
+
+	// 2D DFT of a height x width row-major matrix by SlowDFT along the rows, then the columns.
+	std::vector<std::complex<double>> slowDFT2D(std::vector<std::complex<double>> data, int height, int width, int is) {
+		std::vector<std::complex<double>> line{};
+		for (int i{ 0 }; i < height; i++) {
+			line.assign(data.begin() + static_cast<size_t>(i) * width, data.begin() + static_cast<size_t>(i + 1) * width);
+			FFT::SlowDFT(line, is);
+			std::copy(line.begin(), line.end(), data.begin() + static_cast<size_t>(i) * width);
+		}
+		line.resize(height);
+		for (int j{ 0 }; j < width; j++) {
+			for (int i{ 0 }; i < height; i++)
+				line[i] = data[static_cast<size_t>(i) * width + j];
+			FFT::SlowDFT(line, is);
+			for (int i{ 0 }; i < height; i++)
+				data[static_cast<size_t>(i) * width + j] = line[i];
+		}
+		return data;
+	}
+
+	template <typename T>
+	Result bench1D(const Options& options, int size) {
+		Result result{ "fft", precisionName<T>(), 1, size };
+		const auto input{ randomData<T>(size, size) };
+		std::vector<std::complex<T>> data{};
+
+		if (size <= maxCheckedSize) {
+			data = input;
+			FFT::fft(data, -1);
+			std::vector<std::complex<double>> reference(input.begin(), input.end());
+			FFT::SlowDFT(reference, -1);
+			result.error = relativeRmsError(data, reference);
+			result.passed = result.error <= tolerance<T>(size);
+		}
+
+		measure(options, batchLength<T>(size), [&data, &input] { data = input; }, [&data] { FFT::fft(data, -1); }, result);
+		result.gflops = 5.0 * size * std::log2(std::max(size, 2)) / result.ns;
+		return result;
+	}
+
+	template <typename T>
+	Result bench2D(const Options& options, int height, int width) {
+		Result result{ "fft2D", precisionName<T>(), height, width };
+		const auto input{ randomData<T>(static_cast<size_t>(height) * width, height * 7919 + width) };
+		std::vector<std::vector<std::complex<T>>> data(height);
+		auto reset{ [&data, &input, width] {
+			for (size_t i{ 0 }; i < data.size(); i++)
+				data[i].assign(input.begin() + i * width, input.begin() + (i + 1) * width);
+		} };
+
+		if (static_cast<size_t>(height) * width <= maxCheckedSize * 16) {
+			reset();
+			FFT::fft2D(data, -1);
+			std::vector<std::complex<T>> flat{};
+			for (auto& row : data)
+				flat.insert(flat.end(), row.begin(), row.end());
+			auto reference{ slowDFT2D({ input.begin(), input.end() }, height, width, -1) };
+			result.error = relativeRmsError(flat, reference);
+			result.passed = result.error <= tolerance<T>(std::max(height, width));
+		}
+
+		double points{ static_cast<double>(height) * width };
+		measure(options, batchLength<T>(points), reset, [&data] { FFT::fft2D(data, -1); }, result);
+		result.gflops = 5.0 * points * std::log2(std::max(points, 2.0)) / result.ns;
+		return result;
+	}
+
+	template <typename T>
+	Result benchReal2D(const Options& options, int height, int width) {
+		Result result{ "rfft2D", precisionName<T>(), height, width };
+		const auto input{ randomData<T>(static_cast<size_t>(height) * width, height * 104729 + width) };
+		std::vector<std::vector<T>> data(height, std::vector<T>(width));
+		for (int i{ 0 }; i < height; i++)
+			for (int j{ 0 }; j < width; j++)
+				data[i][j] = input[static_cast<size_t>(i) * width + j].real();
+		std::vector<std::vector<std::complex<T>>> spectrum{};
+
+		if (static_cast<size_t>(height) * width <= maxCheckedSize * 16) {
+			FFT::rfft2D(data, spectrum, -1);
+			std::vector<std::complex<double>> realInput(static_cast<size_t>(height) * width);
+			for (size_t i{ 0 }; i < realInput.size(); i++)
+				realInput[i] = input[i].real();
+			auto full{ slowDFT2D(realInput, height, width, -1) };
+			std::vector<std::complex<T>> flat{};
+			std::vector<std::complex<double>> reference{};
+			for (int i{ 0 }; i < height; i++) {
+				flat.insert(flat.end(), spectrum[i].begin(), spectrum[i].end());
+				reference.insert(reference.end(), full.begin() + static_cast<size_t>(i) * width, full.begin() + static_cast<size_t>(i) * width + spectrum[i].size());
+			}
+			result.error = relativeRmsError(flat, reference);
+			result.passed = result.error <= tolerance<T>(std::max(height, width));
+		}
+
+		// The input is not modified, every batch may be as long as needed.
+		double points{ static_cast<double>(height) * width };
+		measure(options, 1 << 20, [] {}, [&data, &spectrum] { FFT::rfft2D(data, spectrum, -1); }, result);
+		result.gflops = 2.5 * points * std::log2(std::max(points, 2.0)) / result.ns;
+		return result;
+	}
+
+	void printResult(const Result& result, bool last) {
+		std::printf("    {\"transform\": \"%s\", \"precision\": \"%s\", \"height\": %d, \"width\": %d, "
+					"\"ns\": %.1f, \"gflops\": %.3f, \"allocations\": %.2f, \"allocatedBytes\": %.0f, ",
+					result.transform.c_str(), result.precision.c_str(), result.height, result.width,
+					result.ns, result.gflops, result.allocations, result.allocatedBytes);
+		if (result.error >= 0)
+			std::printf("\"error\": %.3e, \"passed\": %s}", result.error, result.passed ? "true" : "false");
+		else
+			std::printf("\"error\": null, \"passed\": true}");
+		std::printf(last ? "\n" : ",\n");
+	}
+
+	template <typename T>
+	void sweep(const Options& options, std::vector<Result>& results) {
+		std::vector<int> sizes1D{};
+		// Powers of two.
+		for (int size{ 4 }; size <= (options.quick ? 1 << 14 : 1 << 22); size *= options.quick ? 4 : 2)
+			sizes1D.push_back(size);
+		// Smooth sizes, with factors 3, 5 and 7.
+		for (int size : { 6, 12, 15, 60, 100, 360, 1000, 1575, 4800, 10080, 100000, 1000000 })
+			if (!options.quick || size <= 10080)
+				sizes1D.push_back(size);
+		// Primes, direct odd radix and Bluestein.
+		for (int size : { 7, 17, 31, 101, 1009, 10007, 100003 })
+			if (!options.quick || size <= 10007)
+				sizes1D.push_back(size);
+
+		for (int size : sizes1D)
+			results.push_back(bench1D<T>(options, size));
+
+		std::vector<std::pair<int, int>> sizes2D{ { 64, 64 }, { 256, 256 }, { 480, 640 }, { 101, 127 }, { 1000, 1000 } };
+		if (!options.quick) {
+			sizes2D.insert(sizes2D.end(), { { 1024, 1024 }, { 2048, 2048 }, { 1080, 1920 }, { 4096, 4096 } });
+		}
+		for (auto [height, width] : sizes2D) {
+			results.push_back(bench2D<T>(options, height, width));
+			results.push_back(benchReal2D<T>(options, height, width));
+		}
+	}
+
+	// Same fft2D at doubling thread counts, the last one being the hardware thread count.
+	std::vector<ScalingPoint> scalingSweep(const Options& options) {
+		const int size{ options.quick ? 1024 : 2048 };
+		const int maxThreads{ std::max(1, static_cast<int>(std::thread::hardware_concurrency())) };
+		std::vector<ScalingPoint> points{};
+		for (int threads{ 1 };; threads = std::min(threads * 2, maxThreads)) {
+			FFT::SetThreadCount(threads);
+			points.push_back({ threads, bench2D<double>(options, size, size).ns });
+			if (threads == maxThreads)
+				break;
+		}
+		FFT::SetThreadCount(options.threads);
+		return points;
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options) {
+		for (int i{ 1 }; i < argc; i++) {
+			if (std::strcmp(argv[i], "--quick") == 0) {
+				options.quick = true;
+				options.minTime = 0.05;
+			}
+			else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+				options.minTime = std::atof(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+				options.threads = std::atoi(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--scaling") == 0) {
+				options.scaling = true;
+			}
+			else {
+				std::fprintf(stderr, "Usage: %s [--quick] [--min-time <seconds>] [--threads <count>] [--scaling]\n", argv[0]);
+				return false;
+			}
+		}
+		return true;
+	}
+
+}
+
+int main(int argc, char** argv) {
+	Options options{};
+	if (!parseOptions(argc, argv, options))
+		return 2;
+	FFT::SetThreadCount(options.threads);
+
+	std::vector<Result> results{};
+	sweep<double>(options, results);
+	sweep<float>(options, results);
+	std::vector<ScalingPoint> scaling{};
+	if (options.scaling)
+		scaling = scalingSweep(options);
+
+	bool passed{ std::all_of(results.begin(), results.end(), [](const Result& result) { return result.passed; }) };
+	FFT::PlanCacheStats cache{ FFT::GetPlanCacheStats() };
+	std::printf("{\n");
+	std::printf("  \"kernels\": \"%s\",\n", FFT::Kernels::Active<double>().name);
+	std::printf("  \"threads\": %d,\n", FFT::GetThreadCount());
+	std::printf("  \"minTime\": %g,\n", options.minTime);
+	std::printf("  \"planCache\": {\"hits\": %llu, \"misses\": %llu, \"evictions\": %llu},\n",
+				static_cast<unsigned long long>(cache.hits), static_cast<unsigned long long>(cache.misses),
+				static_cast<unsigned long long>(cache.evictions));
+	std::printf("  \"passed\": %s,\n", passed ? "true" : "false");
+	if (!scaling.empty()) {
+		std::printf("  \"scaling\": [\n");
+		for (size_t i{ 0 }; i < scaling.size(); i++)
+			std::printf("    {\"threads\": %d, \"ns\": %.1f, \"speedup\": %.2f}%s\n", scaling[i].threads, scaling[i].ns,
+						scaling[0].ns / scaling[i].ns, i + 1 == scaling.size() ? "" : ",");
+		std::printf("  ],\n");
+	}
+	std::printf("  \"results\": [\n");
+	for (size_t i{ 0 }; i < results.size(); i++)
+		printResult(results[i], i + 1 == results.size());
+	std::printf("  ]\n}\n");
+	return passed ? 0 : 1;
+}
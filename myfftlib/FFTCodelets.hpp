@@ -0,0 +1,260 @@
+#ifndef FFT_CODELETS_HPP
+#define FFT_CODELETS_HPP
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <utility>
+
+// Straight-line transforms of small sizes, generated at compile time. Internal to myfftlib.
+// A codelet of size N is a recursive split-radix (powers of two) or radix 3/5 decomposition
+// unrolled by the compiler: no loops, no index arithmetic and all twiddles are constants.
+// The recursion is only cheap when fully inlined, which compilers do not do on their own for the larger sizes.
+#if defined(_MSC_VER)
+#define FFT_CODELET_INLINE __forceinline
+#else
+#define FFT_CODELET_INLINE __attribute__((always_inline)) inline
+#endif
+
+namespace FFT::Codelets {
+
+	// Codelets exist for every size 2..MaxSize without prime factors other than 2, 3 and 5.
+	constexpr int MaxSize{ 64 };
+
+	constexpr bool IsCodeletSize(int size) {
+		if (size < 2 || size > MaxSize)
+			return false;
+		for (int factor : { 2, 3, 5 })
+			while (size % factor == 0)
+				size /= factor;
+		return size == 1;
+	}
+
+	/**
+	 * Out of place transform of one codelet size.
+	 *
+	 * @in In parameter. Data points at in[0], in[stride], ...
+	 * @stride Distance between input data points.
+	 * @out Out parameter for contiguous transformed data. Must not overlap in.
+	 */
+	template <typename T>
+	using Function = void (*)(const std::complex<T>* in, size_t stride, std::complex<T>* out);
+
+	// i * value
+	template <typename T>
+	inline std::complex<T> mulI(std::complex<T> value) {
+		return { -value.imag(), value.real() };
+	}
+
+	// Plain product without the NaN/Inf recovery path of std::complex multiplication.
+	template <typename T>
+	inline std::complex<T> mul(std::complex<T> a, std::complex<T> b) {
+		return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+	}
+
+	template <typename T>
+	inline void radix3Butterfly(std::complex<T>* x, T is) {
+		const T sin60{ static_cast<T>(0.86602540378443864676) };
+		std::complex<T> sum{ x[1] + x[2] };
+		std::complex<T> mid{ x[0] - static_cast<T>(0.5) * sum };
+		std::complex<T> diff{ mulI(x[1] - x[2]) * (is * sin60) };
+		x[0] += sum;
+		x[1] = mid + diff;
+		x[2] = mid - diff;
+	}
+
+	template <typename T>
+	inline void radix5Butterfly(std::complex<T>* x, T is) {
+		const T cos1{ static_cast<T>(0.30901699437494742410) };  // cos(2pi/5)
+		const T cos2{ static_cast<T>(-0.80901699437494742410) }; // cos(4pi/5)
+		const T sin1{ static_cast<T>(0.95105651629515357212) };  // sin(2pi/5)
+		const T sin2{ static_cast<T>(0.58778525229247312917) };  // sin(4pi/5)
+		std::complex<T> sum14{ x[1] + x[4] };
+		std::complex<T> sum23{ x[2] + x[3] };
+		std::complex<T> diff14{ mulI(x[1] - x[4]) * is };
+		std::complex<T> diff23{ mulI(x[2] - x[3]) * is };
+		std::complex<T> re1{ x[0] + cos1 * sum14 + cos2 * sum23 };
+		std::complex<T> re2{ x[0] + cos2 * sum14 + cos1 * sum23 };
+		std::complex<T> im1{ sin1 * diff14 + sin2 * diff23 };
+		std::complex<T> im2{ sin2 * diff14 - sin1 * diff23 };
+		x[0] += sum14 + sum23;
+		x[1] = re1 + im1;
+		x[4] = re1 - im1;
+		x[2] = re2 + im2;
+		x[3] = re2 - im2;
+	}
+
+	namespace Detail {
+
+		constexpr double pi{ 3.14159265358979323846 };
+
+		// Taylor series of sin/cos, accurate to double precision for |x| <= pi/4. std::sin/cos are not constexpr.
+		constexpr double sinSeries(double x) {
+			double term{ x };
+			double sum{ x };
+			for (int n{ 1 }; n < 12; n++) {
+				term *= -x * x / ((2 * n) * (2 * n + 1));
+				sum += term;
+			}
+			return sum;
+		}
+
+		constexpr double cosSeries(double x) {
+			double term{ 1 };
+			double sum{ 1 };
+			for (int n{ 1 }; n < 12; n++) {
+				term *= -x * x / ((2 * n - 1) * (2 * n));
+				sum += term;
+			}
+			return sum;
+		}
+
+		// exp(Sign*2*pi*i*k/N). The angle is reduced to the first octant in integer arithmetic.
+		template <int N, int Sign, typename T>
+		constexpr std::complex<T> root(int k) {
+			k %= N;
+			int quadrant{ 4 * k / N };
+			int rest{ 4 * k - quadrant * N }; // Angle is pi/2 * (quadrant + rest/N).
+			double c{ cosSeries(pi / 2 * rest / N) };
+			double s{ sinSeries(pi / 2 * rest / N) };
+			if (2 * rest > N) {
+				c = sinSeries(pi / 2 * (N - rest) / N);
+				s = cosSeries(pi / 2 * (N - rest) / N);
+			}
+			for (int q{ 0 }; q < quadrant; q++) {
+				double rotated{ -s };
+				s = c;
+				c = rotated;
+			}
+			return { static_cast<T>(c), static_cast<T>(Sign * s) };
+		}
+
+		template <int N, int Sign, typename T>
+		constexpr std::array<std::complex<T>, N> makeRoots() {
+			std::array<std::complex<T>, N> roots{};
+			for (int k{ 0 }; k < N; k++)
+				roots[k] = root<N, Sign, T>(k);
+			return roots;
+		}
+
+		template <int N, int Sign, typename T>
+		constexpr std::array<std::complex<T>, N> Roots{ makeRoots<N, Sign, T>() };
+
+		template <int N, int Sign, typename T>
+		FFT_CODELET_INLINE void dft(const std::complex<T>* in, size_t stride, std::complex<T>* out);
+
+		// Split radix recombination of output k: X[k] = U[k] + W^k Z[k] + W^3k Z'[k], and so on
+		// for k + N/4, k + N/2, k + 3N/4, with U of the even, Z and Z' of the 4m+1 and 4m+3 points.
+		template <int N, int K, int Sign, typename T>
+		FFT_CODELET_INLINE void splitRadixStep(std::complex<T>* out) {
+			constexpr int Quarter{ N / 4 };
+			std::complex<T> u0{ out[K] };
+			std::complex<T> u1{ out[K + Quarter] };
+			std::complex<T> z1{ out[2 * Quarter + K] };
+			std::complex<T> z3{ out[3 * Quarter + K] };
+			if constexpr (K != 0) {
+				z1 = mul(z1, Roots<N, Sign, T>[K]);
+				z3 = mul(z3, Roots<N, Sign, T>[3 * K]);
+			}
+			std::complex<T> sum{ z1 + z3 };
+			std::complex<T> diff{ mulI(z1 - z3) * static_cast<T>(Sign) };
+			out[K] = u0 + sum;
+			out[K + 2 * Quarter] = u0 - sum;
+			out[K + Quarter] = u1 + diff;
+			out[K + 3 * Quarter] = u1 - diff;
+		}
+
+		// Radix R recombination of output k of R transforms of size N/R.
+		template <int N, int R, int K, int Sign, typename T>
+		FFT_CODELET_INLINE void radixStep(std::complex<T>* out) {
+			constexpr int M{ N / R };
+			std::complex<T> x[R];
+			x[0] = out[K];
+			for (int j{ 1 }; j < R; j++)
+				x[j] = K == 0 ? out[j * M + K] : mul(out[j * M + K], Roots<N, Sign, T>[(j * K) % N]);
+			if constexpr (R == 2) {
+				std::complex<T> odd{ x[1] };
+				x[1] = x[0] - odd;
+				x[0] += odd;
+			}
+			else if constexpr (R == 3) {
+				radix3Butterfly(x, static_cast<T>(Sign));
+			}
+			else {
+				radix5Butterfly(x, static_cast<T>(Sign));
+			}
+			for (int j{ 0 }; j < R; j++)
+				out[j * M + K] = x[j];
+		}
+
+		template <int N, int Sign, typename T>
+		FFT_CODELET_INLINE void dft(const std::complex<T>* in, size_t stride, std::complex<T>* out) {
+			if constexpr (N == 1) {
+				out[0] = in[0];
+			}
+			else if constexpr (N == 2) {
+				out[0] = in[0] + in[stride];
+				out[1] = in[0] - in[stride];
+			}
+			else if constexpr (N == 4) {
+				std::complex<T> sum02{ in[0] + in[2 * stride] };
+				std::complex<T> diff02{ in[0] - in[2 * stride] };
+				std::complex<T> sum13{ in[stride] + in[3 * stride] };
+				std::complex<T> diff13{ mulI(in[stride] - in[3 * stride]) * static_cast<T>(Sign) };
+				out[0] = sum02 + sum13;
+				out[1] = diff02 + diff13;
+				out[2] = sum02 - sum13;
+				out[3] = diff02 - diff13;
+			}
+			else if constexpr ((N & (N - 1)) == 0) {
+				dft<N / 2, Sign>(in, 2 * stride, out);
+				dft<N / 4, Sign>(in + stride, 4 * stride, out + N / 2);
+				dft<N / 4, Sign>(in + 3 * stride, 4 * stride, out + 3 * N / 4);
+				[out]<size_t... K>(std::index_sequence<K...>) {
+					(splitRadixStep<N, K, Sign>(out), ...);
+				}(std::make_index_sequence<N / 4>{});
+			}
+			else {
+				// Odd factors outermost, so that the innermost transforms are powers of two.
+				constexpr int R{ N % 3 == 0 ? 3 : N % 5 == 0 ? 5 : 2 };
+				constexpr int M{ N / R };
+				for (int j{ 0 }; j < R; j++)
+					dft<M, Sign>(in + j * stride, R * stride, out + j * M);
+				[out]<size_t... K>(std::index_sequence<K...>) {
+					(radixStep<N, R, K, Sign>(out), ...);
+				}(std::make_index_sequence<M>{});
+			}
+		}
+
+		template <int N, int Sign, typename T>
+		void run(const std::complex<T>* in, size_t stride, std::complex<T>* out) {
+			if constexpr (IsCodeletSize(N))
+				dft<N, Sign>(in, stride, out);
+		}
+
+		template <typename T, int Sign, size_t... N>
+		constexpr std::array<Function<T>, MaxSize + 1> makeTable(std::index_sequence<N...>) {
+			return { (IsCodeletSize(N) ? &run<N, Sign, T> : nullptr)... };
+		}
+
+	}
+
+	/**
+	 * Codelet for a size, or nullptr if IsCodeletSize(size) is false.
+	 *
+	 * @is Direction of transform. Should be -1/1 (forward/inverse).
+	 */
+	template <typename T>
+	Function<T> Get(int size, int is) {
+		static constexpr auto forward{ Detail::makeTable<T, -1>(std::make_index_sequence<MaxSize + 1>{}) };
+		static constexpr auto inverse{ Detail::makeTable<T, 1>(std::make_index_sequence<MaxSize + 1>{}) };
+		if (!IsCodeletSize(size))
+			return nullptr;
+		return is < 0 ? forward[size] : inverse[size];
+	}
+
+}
+
+#undef FFT_CODELET_INLINE
+
+#endif
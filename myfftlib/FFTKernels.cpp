@@ -0,0 +1,132 @@
+#include "FFTKernels.hpp"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(FFT_X86_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace FFT::Kernels {
+
+	namespace {
+
+		// Plain product without the NaN/Inf recovery path of std::complex multiplication.
+		template <typename T>
+		inline std::complex<T> mul(std::complex<T> a, std::complex<T> b) {
+			return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+		}
+
+		template <typename T>
+		void radix2PassScalar(std::complex<T>* data, int size, int span, const std::complex<T>* twiddles) {
+			for (int block{ 0 }; block < size; block += 2 * span) {
+				std::complex<T>* even{ data + block };
+				std::complex<T>* odd{ even + span };
+				for (int k{ 0 }; k < span; k++) {
+					std::complex<T> oddTerm{ mul(odd[k], twiddles[k]) };
+					odd[k] = even[k] - oddTerm;
+					even[k] += oddTerm;
+				}
+			}
+		}
+
+		template <typename T>
+		void radix4PassScalar(std::complex<T>* data, int size, int span, const std::complex<T>* twiddles, int is) {
+			const T sign{ static_cast<T>(is) };
+			for (int block{ 0 }; block < size; block += 4 * span) {
+				std::complex<T>* x0{ data + block };
+				std::complex<T>* x1{ x0 + span };
+				std::complex<T>* x2{ x1 + span };
+				std::complex<T>* x3{ x2 + span };
+				for (int k{ 0 }; k < span; k++) {
+					std::complex<T> a0{ x0[k] };
+					std::complex<T> a1{ mul(x1[k], twiddles[k]) };
+					std::complex<T> a2{ mul(x2[k], twiddles[span + k]) };
+					std::complex<T> a3{ mul(x3[k], twiddles[2 * span + k]) };
+					std::complex<T> sum02{ a0 + a2 };
+					std::complex<T> diff02{ a0 - a2 };
+					std::complex<T> sum13{ a1 + a3 };
+					std::complex<T> diff13{ a1 - a3 };
+					// is * i * diff13
+					diff13 = { -sign * diff13.imag(), sign * diff13.real() };
+					x0[k] = sum02 + sum13;
+					x1[k] = diff02 + diff13;
+					x2[k] = sum02 - sum13;
+					x3[k] = diff02 - diff13;
+				}
+			}
+		}
+
+		struct CpuFeatures {
+			bool sse2{};
+			bool avx2{};
+			bool avx512{};
+		};
+
+		CpuFeatures detectCpu() {
+			CpuFeatures features{};
+#if defined(FFT_X86_KERNELS) && defined(_MSC_VER)
+			int info[4]{};
+			__cpuid(info, 0);
+			int maxLeaf{ info[0] };
+			__cpuid(info, 1);
+			features.sse2 = (info[3] & (1 << 26)) != 0;
+			bool fma{ (info[2] & (1 << 12)) != 0 };
+			bool osxsave{ (info[2] & (1 << 27)) != 0 };
+			// The OS has to save the wide registers on context switch.
+			unsigned long long xcr0{ osxsave ? _xgetbv(0) : 0 };
+			bool avxState{ (xcr0 & 0x6) == 0x6 };
+			bool avx512State{ (xcr0 & 0xE6) == 0xE6 };
+			if (maxLeaf >= 7) {
+				__cpuidex(info, 7, 0);
+				features.avx2 = fma && avxState && (info[1] & (1 << 5)) != 0;
+				features.avx512 = avx512State && (info[1] & (1 << 16)) != 0;
+			}
+#elif defined(FFT_X86_KERNELS)
+			__builtin_cpu_init();
+			features.sse2 = __builtin_cpu_supports("sse2");
+			features.avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+			features.avx512 = __builtin_cpu_supports("avx512f");
+#endif
+			return features;
+		}
+
+		template <typename T>
+		const KernelTable<T>& select() {
+			CpuFeatures cpu{ detectCpu() };
+			const char* requested{ std::getenv("FFT_KERNELS") };
+			auto allowed{ [requested](const char* name) {
+				// Without a request the widest supported set wins, otherwise only the requested one.
+				return requested == nullptr || std::strcmp(requested, name) == 0;
+			} };
+#if defined(FFT_X86_KERNELS)
+			if (cpu.avx512 && allowed("avx512"))
+				return Avx512<T>();
+			if (cpu.avx2 && allowed("avx2"))
+				return Avx2<T>();
+			if (cpu.sse2 && allowed("sse2"))
+				return Sse2<T>();
+#endif
+			return Scalar<T>();
+		}
+
+	}
+
+	template <typename T>
+	const KernelTable<T>& Active() {
+		static const KernelTable<T>& table{ select<T>() };
+		return table;
+	}
+
+	template <typename T>
+	const KernelTable<T>& Scalar() {
+		static const KernelTable<T> table{ "scalar", radix2PassScalar<T>, radix4PassScalar<T> };
+		return table;
+	}
+
+	template const KernelTable<float>& Active<float>();
+	template const KernelTable<double>& Active<double>();
+	template const KernelTable<float>& Scalar<float>();
+	template const KernelTable<double>& Scalar<double>();
+
+}
@@ -0,0 +1,60 @@
+#ifndef FFT_KERNELS_HPP
+#define FFT_KERNELS_HPP
+
+#include <complex>
+
+// Butterfly stage kernels with runtime instruction set selection. Internal to myfftlib.
+// Every getter below is instantiated for T = float and T = double.
+namespace FFT::Kernels {
+
+	/**
+	 * Radix-2 stage over the whole data array.
+	 *
+	 * @data In/out parameter. Should point to size data points.
+	 * @size Transform size.
+	 * @span Distance between butterfly inputs.
+	 * @twiddles span twiddles, W_{2*span}^k at [k].
+	 */
+	template <typename T>
+	using Radix2Pass = void (*)(std::complex<T>* data, int size, int span, const std::complex<T>* twiddles);
+
+	/**
+	 * Radix-4 stage over the whole data array.
+	 *
+	 * @twiddles 3 * span twiddles, W_{4*span}^{j*k} at [(j - 1) * span + k].
+	 * @is Direction of transform. Should be -1/1 (forward/inverse).
+	 */
+	template <typename T>
+	using Radix4Pass = void (*)(std::complex<T>* data, int size, int span, const std::complex<T>* twiddles, int is);
+
+	template <typename T>
+	struct KernelTable {
+		const char* name;
+		Radix2Pass<T> radix2;
+		Radix4Pass<T> radix4;
+	};
+
+	/**
+	 * Kernels of the widest instruction set supported by the CPU, detected once.
+	 * Environment variable FFT_KERNELS (scalar/sse2/avx2/avx512) may request a narrower one.
+	 */
+	template <typename T>
+	const KernelTable<T>& Active();
+
+	template <typename T>
+	const KernelTable<T>& Scalar();
+
+#if defined(FFT_X86_KERNELS)
+	template <typename T>
+	const KernelTable<T>& Sse2();
+
+	template <typename T>
+	const KernelTable<T>& Avx2();
+
+	template <typename T>
+	const KernelTable<T>& Avx512();
+#endif
+
+}
+
+#endif
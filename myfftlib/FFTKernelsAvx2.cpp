@@ -0,0 +1,66 @@
+#include "FFTKernelsSimd.hpp"
+#include <immintrin.h>
+
+namespace FFT::Kernels {
+
+	namespace {
+
+		template <typename T>
+		struct VecAvx2;
+
+		// Two complex doubles per register, complex multiplication with fused multiply-add.
+		template <>
+		struct VecAvx2<double> {
+			using Scalar = double;
+			using Type = __m256d;
+			static constexpr int Width{ 2 };
+
+			static Type Load(const double* p) { return _mm256_loadu_pd(p); }
+			static void Store(double* p, Type a) { _mm256_storeu_pd(p, a); }
+			static Type Add(Type a, Type b) { return _mm256_add_pd(a, b); }
+			static Type Sub(Type a, Type b) { return _mm256_sub_pd(a, b); }
+			static Type MulReal(Type a, Type b) { return _mm256_mul_pd(a, b); }
+			static Type Swap(Type a) { return _mm256_permute_pd(a, 0x5); }
+			static Type RotationSign(int is) { return _mm256_set_pd(is, -is, is, -is); }
+
+			static Type Mul(Type a, Type b) {
+				Type real{ _mm256_movedup_pd(b) };
+				Type imag{ _mm256_permute_pd(b, 0xF) };
+				return _mm256_fmaddsub_pd(a, real, _mm256_mul_pd(Swap(a), imag));
+			}
+		};
+
+		// Four complex floats per register.
+		template <>
+		struct VecAvx2<float> {
+			using Scalar = float;
+			using Type = __m256;
+			static constexpr int Width{ 4 };
+
+			static Type Load(const float* p) { return _mm256_loadu_ps(p); }
+			static void Store(float* p, Type a) { _mm256_storeu_ps(p, a); }
+			static Type Add(Type a, Type b) { return _mm256_add_ps(a, b); }
+			static Type Sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+			static Type MulReal(Type a, Type b) { return _mm256_mul_ps(a, b); }
+			static Type Swap(Type a) { return _mm256_permute_ps(a, 0xB1); }
+			static Type RotationSign(int is) { return _mm256_set_ps(is, -is, is, -is, is, -is, is, -is); }
+
+			static Type Mul(Type a, Type b) {
+				Type real{ _mm256_moveldup_ps(b) };
+				Type imag{ _mm256_movehdup_ps(b) };
+				return _mm256_fmaddsub_ps(a, real, _mm256_mul_ps(Swap(a), imag));
+			}
+		};
+
+	}
+
+	template <typename T>
+	const KernelTable<T>& Avx2() {
+		static const KernelTable<T> table{ "avx2", Simd::radix2Pass<VecAvx2<T>>, Simd::radix4Pass<VecAvx2<T>> };
+		return table;
+	}
+
+	template const KernelTable<float>& Avx2<float>();
+	template const KernelTable<double>& Avx2<double>();
+
+}
@@ -0,0 +1,75 @@
+#include "FFTKernelsSimd.hpp"
+#include <immintrin.h>
+
+namespace FFT::Kernels {
+
+	namespace {
+
+		// The shuffles use the masked intrinsics with every lane selected. The unmasked ones pass
+		// GCC an _mm512_undefined_* source, which -Wmaybe-uninitialized reports as uninitialized.
+		// With a full mask the same single instruction is emitted.
+		template <typename T>
+		struct VecAvx512;
+
+		// Four complex doubles per register, only AVX-512F instructions.
+		template <>
+		struct VecAvx512<double> {
+			using Scalar = double;
+			using Type = __m512d;
+			static constexpr int Width{ 4 };
+			static constexpr __mmask8 allLanes{ 0xFF };
+
+			static Type Load(const double* p) { return _mm512_loadu_pd(p); }
+			static void Store(double* p, Type a) { _mm512_storeu_pd(p, a); }
+			static Type Add(Type a, Type b) { return _mm512_add_pd(a, b); }
+			static Type Sub(Type a, Type b) { return _mm512_sub_pd(a, b); }
+			static Type MulReal(Type a, Type b) { return _mm512_mul_pd(a, b); }
+			static Type Swap(Type a) { return _mm512_mask_permute_pd(a, allLanes, a, 0x55); }
+			static Type RotationSign(int is) { return _mm512_set_pd(is, -is, is, -is, is, -is, is, -is); }
+
+			static Type Mul(Type a, Type b) {
+				Type real{ _mm512_mask_movedup_pd(b, allLanes, b) };
+				Type imag{ _mm512_mask_permute_pd(b, allLanes, b, 0xFF) };
+				return _mm512_fmaddsub_pd(a, real, _mm512_mul_pd(Swap(a), imag));
+			}
+		};
+
+		// Eight complex floats per register.
+		template <>
+		struct VecAvx512<float> {
+			using Scalar = float;
+			using Type = __m512;
+			static constexpr int Width{ 8 };
+			static constexpr __mmask16 allLanes{ 0xFFFF };
+
+			static Type Load(const float* p) { return _mm512_loadu_ps(p); }
+			static void Store(float* p, Type a) { _mm512_storeu_ps(p, a); }
+			static Type Add(Type a, Type b) { return _mm512_add_ps(a, b); }
+			static Type Sub(Type a, Type b) { return _mm512_sub_ps(a, b); }
+			static Type MulReal(Type a, Type b) { return _mm512_mul_ps(a, b); }
+			static Type Swap(Type a) { return _mm512_mask_permute_ps(a, allLanes, a, 0xB1); }
+
+			static Type RotationSign(int is) {
+				float s{ static_cast<float>(is) };
+				return _mm512_set_ps(s, -s, s, -s, s, -s, s, -s, s, -s, s, -s, s, -s, s, -s);
+			}
+
+			static Type Mul(Type a, Type b) {
+				Type real{ _mm512_mask_moveldup_ps(b, allLanes, b) };
+				Type imag{ _mm512_mask_movehdup_ps(b, allLanes, b) };
+				return _mm512_fmaddsub_ps(a, real, _mm512_mul_ps(Swap(a), imag));
+			}
+		};
+
+	}
+
+	template <typename T>
+	const KernelTable<T>& Avx512() {
+		static const KernelTable<T> table{ "avx512", Simd::radix2Pass<VecAvx512<T>>, Simd::radix4Pass<VecAvx512<T>> };
+		return table;
+	}
+
+	template const KernelTable<float>& Avx512<float>();
+	template const KernelTable<double>& Avx512<double>();
+
+}
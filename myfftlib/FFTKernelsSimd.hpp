@@ -0,0 +1,70 @@
+#ifndef FFT_KERNELS_SIMD_HPP
+#define FFT_KERNELS_SIMD_HPP
+
+#include "FFTKernels.hpp"
+
+// Stage kernels written against a vector type V holding V::Width interleaved complex values of V::Scalar.
+// Included only by the per instruction set translation units, each with its own V, so the
+// instantiations never mix. Only intrinsics are used here: std::complex operators would be
+// emitted with the wider instruction set and could be picked by the linker for scalar code.
+namespace FFT::Kernels::Simd {
+
+	template <typename V>
+	void radix2Pass(std::complex<typename V::Scalar>* data, int size, int span, const std::complex<typename V::Scalar>* twiddles) {
+		using T = typename V::Scalar;
+		if (span % V::Width != 0) {
+			Scalar<T>().radix2(data, size, span, twiddles);
+			return;
+		}
+		T* values{ reinterpret_cast<T*>(data) };
+		const T* factors{ reinterpret_cast<const T*>(twiddles) };
+		for (int block{ 0 }; block < size; block += 2 * span) {
+			T* even{ values + 2 * block };
+			T* odd{ even + 2 * span };
+			for (int k{ 0 }; k < span; k += V::Width) {
+				auto a{ V::Load(even + 2 * k) };
+				auto b{ V::Mul(V::Load(odd + 2 * k), V::Load(factors + 2 * k)) };
+				V::Store(even + 2 * k, V::Add(a, b));
+				V::Store(odd + 2 * k, V::Sub(a, b));
+			}
+		}
+	}
+
+	template <typename V>
+	void radix4Pass(std::complex<typename V::Scalar>* data, int size, int span, const std::complex<typename V::Scalar>* twiddles, int is) {
+		using T = typename V::Scalar;
+		if (span % V::Width != 0) {
+			Scalar<T>().radix4(data, size, span, twiddles, is);
+			return;
+		}
+		T* values{ reinterpret_cast<T*>(data) };
+		const T* factors1{ reinterpret_cast<const T*>(twiddles) };
+		const T* factors2{ factors1 + 2 * span };
+		const T* factors3{ factors2 + 2 * span };
+		// Multiplication by is*i is a swap of real/imaginary parts and a sign change.
+		const auto sign{ V::RotationSign(is) };
+		for (int block{ 0 }; block < size; block += 4 * span) {
+			T* x0{ values + 2 * block };
+			T* x1{ x0 + 2 * span };
+			T* x2{ x1 + 2 * span };
+			T* x3{ x2 + 2 * span };
+			for (int k{ 0 }; k < 2 * span; k += 2 * V::Width) {
+				auto a0{ V::Load(x0 + k) };
+				auto a1{ V::Mul(V::Load(x1 + k), V::Load(factors1 + k)) };
+				auto a2{ V::Mul(V::Load(x2 + k), V::Load(factors2 + k)) };
+				auto a3{ V::Mul(V::Load(x3 + k), V::Load(factors3 + k)) };
+				auto sum02{ V::Add(a0, a2) };
+				auto diff02{ V::Sub(a0, a2) };
+				auto sum13{ V::Add(a1, a3) };
+				auto diff13{ V::MulReal(V::Swap(V::Sub(a1, a3)), sign) };
+				V::Store(x0 + k, V::Add(sum02, sum13));
+				V::Store(x1 + k, V::Add(diff02, diff13));
+				V::Store(x2 + k, V::Sub(sum02, sum13));
+				V::Store(x3 + k, V::Sub(diff02, diff13));
+			}
+		}
+	}
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#include "FFTKernelsSimd.hpp"
+#include <emmintrin.h>
+
+namespace FFT::Kernels {
+
+	namespace {
+
+		template <typename T>
+		struct VecSse2;
+
+		// One complex double per register.
+		template <>
+		struct VecSse2<double> {
+			using Scalar = double;
+			using Type = __m128d;
+			static constexpr int Width{ 1 };
+
+			static Type Load(const double* p) { return _mm_loadu_pd(p); }
+			static void Store(double* p, Type a) { _mm_storeu_pd(p, a); }
+			static Type Add(Type a, Type b) { return _mm_add_pd(a, b); }
+			static Type Sub(Type a, Type b) { return _mm_sub_pd(a, b); }
+			static Type MulReal(Type a, Type b) { return _mm_mul_pd(a, b); }
+			static Type Swap(Type a) { return _mm_shuffle_pd(a, a, 1); }
+			static Type RotationSign(int is) { return _mm_set_pd(is, -is); }
+
+			static Type Mul(Type a, Type b) {
+				Type real{ _mm_unpacklo_pd(b, b) };
+				Type imag{ _mm_unpackhi_pd(b, b) };
+				Type cross{ _mm_mul_pd(Swap(a), imag) };
+				return _mm_add_pd(_mm_mul_pd(a, real), _mm_mul_pd(cross, _mm_set_pd(1.0, -1.0)));
+			}
+		};
+
+		// Two complex floats per register.
+		template <>
+		struct VecSse2<float> {
+			using Scalar = float;
+			using Type = __m128;
+			static constexpr int Width{ 2 };
+
+			static Type Load(const float* p) { return _mm_loadu_ps(p); }
+			static void Store(float* p, Type a) { _mm_storeu_ps(p, a); }
+			static Type Add(Type a, Type b) { return _mm_add_ps(a, b); }
+			static Type Sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+			static Type MulReal(Type a, Type b) { return _mm_mul_ps(a, b); }
+			static Type Swap(Type a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+			static Type RotationSign(int is) { return _mm_set_ps(is, -is, is, -is); }
+
+			static Type Mul(Type a, Type b) {
+				Type real{ _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 0, 0)) };
+				Type imag{ _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 1, 1)) };
+				Type cross{ _mm_mul_ps(Swap(a), imag) };
+				return _mm_add_ps(_mm_mul_ps(a, real), _mm_mul_ps(cross, _mm_set_ps(1.0f, -1.0f, 1.0f, -1.0f)));
+			}
+		};
+
+	}
+
+	template <typename T>
+	const KernelTable<T>& Sse2() {
+		static const KernelTable<T> table{ "sse2", Simd::radix2Pass<VecSse2<T>>, Simd::radix4Pass<VecSse2<T>> };
+		return table;
+	}
+
+	template const KernelTable<float>& Sse2<float>();
+	template const KernelTable<double>& Sse2<double>();
+
+}
@@ -0,0 +1,316 @@
+#include "OutOfCore.hpp"
+#include "FFT.hpp"
+#include "Parallel.hpp"
+#include "PlanCache.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace FFT {
+
+	namespace {
+
+		// Scratch file of fixed size, mapped a view at a time. The file is deleted when closed.
+		class ScratchFile {
+		public:
+			// View of a byte range of the file, unmapped on destruction. Data() is nullptr if mapping failed.
+			class View {
+			public:
+				View() = default;
+				View(const View&) = delete;
+				View& operator=(const View&) = delete;
+				~View() { unmap(); }
+
+				void* Data() const { return m_data; }
+
+			private:
+				friend class ScratchFile;
+
+				void unmap() {
+					if (m_base == nullptr)
+						return;
+#if defined(_WIN32)
+					UnmapViewOfFile(m_base);
+#else
+					munmap(m_base, m_length);
+#endif
+					m_base = nullptr;
+				}
+
+				void* m_base{ nullptr };    // Start of the mapping, aligned down to the mapping granularity.
+				size_t m_length{};
+				void* m_data{ nullptr };
+			};
+
+			ScratchFile(const std::filesystem::path& directory, size_t size) {
+				std::error_code error{};
+				std::filesystem::path folder{ directory.empty() ? std::filesystem::temp_directory_path(error) : directory };
+				if (error || size == 0)
+					return;
+#if defined(_WIN32)
+				SYSTEM_INFO info{};
+				GetSystemInfo(&info);
+				m_granularity = info.dwAllocationGranularity;
+				wchar_t name[MAX_PATH]{};
+				if (GetTempFileNameW(folder.c_str(), L"fft", 0, name) == 0)
+					return;
+				m_file = CreateFileW(name, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+									 FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+				if (m_file == INVALID_HANDLE_VALUE) {
+					DeleteFileW(name);
+					return;
+				}
+				m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE,
+											   static_cast<DWORD>(static_cast<unsigned long long>(size) >> 32), static_cast<DWORD>(size), nullptr);
+				m_open = m_mapping != nullptr;
+#else
+				m_granularity = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+				std::string name{ (folder / "fft-scratch-XXXXXX").string() };
+				m_file = mkstemp(name.data());
+				if (m_file < 0)
+					return;
+				// Unlinked right away, the space is released when the descriptor is closed, even after a crash.
+				unlink(name.c_str());
+				// The space is reserved up front: on a full disk a write through the mapping of a sparse
+				// file raises SIGBUS, this fails here and the caller falls back to the in-core transform.
+				// Only file systems without fallocate get a plain, sparse ftruncate.
+				int reserved{ posix_fallocate(m_file, 0, static_cast<off_t>(size)) };
+				if (reserved == EOPNOTSUPP || reserved == EINVAL)
+					reserved = ftruncate(m_file, static_cast<off_t>(size));
+				m_open = reserved == 0;
+#endif
+			}
+
+			ScratchFile(const ScratchFile&) = delete;
+			ScratchFile& operator=(const ScratchFile&) = delete;
+
+			~ScratchFile() {
+#if defined(_WIN32)
+				if (m_mapping != nullptr)
+					CloseHandle(m_mapping);
+				if (m_file != INVALID_HANDLE_VALUE)
+					CloseHandle(m_file);
+#else
+				if (m_file >= 0)
+					close(m_file);
+#endif
+			}
+
+			bool IsOpen() const { return m_open; }
+
+			// Map bytes [offset, offset + length) into view, replacing what view mapped before.
+			bool Map(size_t offset, size_t length, View& view) const {
+				view.unmap();
+				view.m_data = nullptr;
+				size_t alignedOffset{ offset / m_granularity * m_granularity };
+				size_t alignedLength{ length + (offset - alignedOffset) };
+#if defined(_WIN32)
+				void* base{ MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, static_cast<DWORD>(static_cast<unsigned long long>(alignedOffset) >> 32),
+										  static_cast<DWORD>(alignedOffset), alignedLength) };
+				if (base == nullptr)
+					return false;
+#else
+				void* base{ mmap(nullptr, alignedLength, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, static_cast<off_t>(alignedOffset)) };
+				if (base == MAP_FAILED)
+					return false;
+#endif
+				view.m_base = base;
+				view.m_length = alignedLength;
+				view.m_data = static_cast<char*>(base) + (offset - alignedOffset);
+				return true;
+			}
+
+		private:
+			bool m_open{ false };
+			size_t m_granularity{ 1 };
+#if defined(_WIN32)
+			HANDLE m_file{ INVALID_HANDLE_VALUE };
+			HANDLE m_mapping{ nullptr };
+#else
+			int m_file{ -1 };
+#endif
+		};
+
+		// Rows/columns per worker thread, as in FFT.cpp.
+		int parallelGrain(int length) {
+			const int minPointsPerThread{ 1 << 16 };
+			return std::max(1, minPointsPerThread / std::max(length, 1));
+		}
+
+		// Out-of-core transform of a matrix of height x columns complex points.
+		// loadRows(first, count, rows) fills count rows, each of columns points, and transforms them along the rows.
+		// storeRows(first, count, rows) takes the same rows after the column transforms.
+		// extraRowBytes is memory loadRows/storeRows need per row besides the rows themselves.
+		// The file holds panels of panelWidth columns, each a contiguous panelWidth x height matrix.
+		template <typename T, typename LoadRows, typename StoreRows>
+		bool transformOutOfCore(int height, int columns, size_t extraRowBytes, LoadRows loadRows, StoreRows storeRows, int is, const OutOfCoreOptions& options) {
+			const size_t pointBytes{ sizeof(std::complex<T>) };
+			const size_t budget{ std::max<size_t>(options.memoryBudget, 1) };
+			// At least one column, even if a column alone exceeds the budget.
+			int panelWidth{ static_cast<int>(std::clamp<size_t>(budget / (static_cast<size_t>(height) * pointBytes), 1, columns)) };
+			int panels{ (columns + panelWidth - 1) / panelWidth };
+			// A row panel is held in a buffer and mapped one column panel at a time.
+			size_t rowBytes{ (static_cast<size_t>(columns) + panelWidth) * pointBytes + extraRowBytes };
+			int panelHeight{ static_cast<int>(std::clamp<size_t>(budget / rowBytes, 1, height)) };
+
+			ScratchFile file(options.scratchDirectory, static_cast<size_t>(height) * columns * pointBytes);
+			if (!file.IsOpen())
+				return false;
+
+			auto panelOffset{ [height, panelWidth, pointBytes](int panel) { return static_cast<size_t>(panel) * panelWidth * height * pointBytes; } };
+			auto panelColumns{ [columns, panelWidth](int panel) { return std::min(panelWidth, columns - panel * panelWidth); } };
+
+			std::vector<std::complex<T>> rows(static_cast<size_t>(panelHeight) * columns);
+			ScratchFile::View view{};
+
+			// Rows in, scattered into the column panels.
+			for (int first{ 0 }; first < height; first += panelHeight) {
+				int count{ std::min(panelHeight, height - first) };
+				loadRows(first, count, rows.data());
+				for (int panel{ 0 }; panel < panels; panel++) {
+					int width{ panelColumns(panel) };
+					if (!file.Map(panelOffset(panel) + static_cast<size_t>(first) * width * pointBytes, static_cast<size_t>(count) * width * pointBytes, view))
+						return false;
+					auto* block{ static_cast<std::complex<T>*>(view.Data()) };
+					for (int r{ 0 }; r < count; r++)
+						std::memcpy(block + static_cast<size_t>(r) * width, rows.data() + static_cast<size_t>(r) * columns + panel * panelWidth, width * pointBytes);
+				}
+			}
+
+			// Whole columns, a panel at a time.
+			rows.clear();
+			rows.shrink_to_fit();
+			for (int panel{ 0 }; panel < panels; panel++) {
+				int width{ panelColumns(panel) };
+				if (!file.Map(panelOffset(panel), static_cast<size_t>(height) * width * pointBytes, view))
+					return false;
+				fftBatch(static_cast<std::complex<T>*>(view.Data()), height, width, width, 1, is);
+			}
+
+			// Rows gathered from the column panels, out.
+			rows.resize(static_cast<size_t>(panelHeight) * columns);
+			for (int first{ 0 }; first < height; first += panelHeight) {
+				int count{ std::min(panelHeight, height - first) };
+				for (int panel{ 0 }; panel < panels; panel++) {
+					int width{ panelColumns(panel) };
+					if (!file.Map(panelOffset(panel) + static_cast<size_t>(first) * width * pointBytes, static_cast<size_t>(count) * width * pointBytes, view))
+						return false;
+					auto* block{ static_cast<const std::complex<T>*>(view.Data()) };
+					for (int r{ 0 }; r < count; r++)
+						std::memcpy(rows.data() + static_cast<size_t>(r) * columns + panel * panelWidth, block + static_cast<size_t>(r) * width, width * pointBytes);
+				}
+				storeRows(first, count, rows.data());
+			}
+			return true;
+		}
+
+	}
+
+	template <typename T>
+	bool fft2DOutOfCore(int height, int width,
+						const std::function<void(int, std::complex<T>*)>& readRow,
+						const std::function<void(int, const std::complex<T>*)>& writeRow,
+						int is,
+						const OutOfCoreOptions& options) {
+		if (height <= 0 || width <= 0)
+			return true;
+		auto rowPlan{ GetPlan<T>(width, is) };
+
+		auto loadRows{ [&readRow, &rowPlan, width](int first, int count, std::complex<T>* rows) {
+			for (int r{ 0 }; r < count; r++)
+				readRow(first + r, rows + static_cast<size_t>(r) * width);
+			ParallelFor(count, parallelGrain(width), [rows, width, &rowPlan](int begin, int end) {
+				for (int r{ begin }; r < end; r++)
+					rowPlan->Execute(rows + static_cast<size_t>(r) * width);
+			});
+		} };
+		auto storeRows{ [&writeRow, width](int first, int count, std::complex<T>* rows) {
+			for (int r{ 0 }; r < count; r++)
+				writeRow(first + r, rows + static_cast<size_t>(r) * width);
+		} };
+		return transformOutOfCore<T>(height, width, 0, loadRows, storeRows, is, options);
+	}
+
+	template <typename T>
+	bool rfft2DOutOfCore(int height, int width,
+						 const std::function<void(int, T*)>& readRow,
+						 const std::function<void(int, const std::complex<T>*)>& writeRow,
+						 int is,
+						 const OutOfCoreOptions& options) {
+		if (height <= 0 || width <= 0)
+			return true;
+		auto rowPlan{ GetRealPlan<T>(width, is) };
+		int columns{ rowPlan->SpectrumSize() };
+		std::vector<T> data{};
+
+		auto loadRows{ [&readRow, &rowPlan, &data, width, columns](int first, int count, std::complex<T>* rows) {
+			data.resize(static_cast<size_t>(count) * width);
+			for (int r{ 0 }; r < count; r++)
+				readRow(first + r, data.data() + static_cast<size_t>(r) * width);
+			ParallelFor(count, parallelGrain(width), [rows, width, columns, &data, &rowPlan](int begin, int end) {
+				for (int r{ begin }; r < end; r++)
+					rowPlan->Forward(data.data() + static_cast<size_t>(r) * width, rows + static_cast<size_t>(r) * columns);
+			});
+		} };
+		auto storeRows{ [&writeRow, columns](int first, int count, std::complex<T>* rows) {
+			for (int r{ 0 }; r < count; r++)
+				writeRow(first + r, rows + static_cast<size_t>(r) * columns);
+		} };
+		return transformOutOfCore<T>(height, columns, width * sizeof(T), loadRows, storeRows, is, options);
+	}
+
+	template <typename T>
+	bool irfft2DOutOfCore(int height, int width,
+						  const std::function<void(int, std::complex<T>*)>& readRow,
+						  const std::function<void(int, const T*)>& writeRow,
+						  int is,
+						  const OutOfCoreOptions& options) {
+		if (height <= 0 || width <= 0)
+			return true;
+		auto rowPlan{ GetRealPlan<T>(width, -is) };
+		int columns{ rowPlan->SpectrumSize() };
+		std::vector<T> data{};
+
+		auto loadRows{ [&readRow, columns](int first, int count, std::complex<T>* rows) {
+			for (int r{ 0 }; r < count; r++)
+				readRow(first + r, rows + static_cast<size_t>(r) * columns);
+		} };
+		auto storeRows{ [&writeRow, &rowPlan, &data, width, columns](int first, int count, std::complex<T>* rows) {
+			data.resize(static_cast<size_t>(count) * width);
+			ParallelFor(count, parallelGrain(width), [rows, width, columns, &data, &rowPlan](int begin, int end) {
+				for (int r{ begin }; r < end; r++)
+					rowPlan->Inverse(rows + static_cast<size_t>(r) * columns, data.data() + static_cast<size_t>(r) * width);
+			});
+			for (int r{ 0 }; r < count; r++)
+				writeRow(first + r, data.data() + static_cast<size_t>(r) * width);
+		} };
+		return transformOutOfCore<T>(height, columns, width * sizeof(T), loadRows, storeRows, is, options);
+	}
+
+	template bool fft2DOutOfCore(int, int, const std::function<void(int, std::complex<float>*)>&,
+								 const std::function<void(int, const std::complex<float>*)>&, int, const OutOfCoreOptions&);
+	template bool fft2DOutOfCore(int, int, const std::function<void(int, std::complex<double>*)>&,
+								 const std::function<void(int, const std::complex<double>*)>&, int, const OutOfCoreOptions&);
+	template bool rfft2DOutOfCore(int, int, const std::function<void(int, float*)>&,
+								  const std::function<void(int, const std::complex<float>*)>&, int, const OutOfCoreOptions&);
+	template bool rfft2DOutOfCore(int, int, const std::function<void(int, double*)>&,
+								  const std::function<void(int, const std::complex<double>*)>&, int, const OutOfCoreOptions&);
+	template bool irfft2DOutOfCore(int, int, const std::function<void(int, std::complex<float>*)>&,
+								   const std::function<void(int, const float*)>&, int, const OutOfCoreOptions&);
+	template bool irfft2DOutOfCore(int, int, const std::function<void(int, std::complex<double>*)>&,
+								   const std::function<void(int, const double*)>&, int, const OutOfCoreOptions&);
+
+}
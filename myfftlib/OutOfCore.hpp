@@ -0,0 +1,71 @@
+#ifndef FFT_OUT_OF_CORE_HPP
+#define FFT_OUT_OF_CORE_HPP
+
+#include <complex>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+
+namespace FFT {
+
+	/**
+	 * Memory and scratch file settings of the out-of-core transforms.
+	 *
+	 * The matrix being transformed lives in a scratch file, stored as panels of whole columns.
+	 * Rows are streamed in a panel of rows at a time, transformed and scattered into the column
+	 * panels, then every column panel is mapped and transformed in turn, then the rows are
+	 * gathered and streamed out. Buffers and mapped views together stay within memoryBudget.
+	 */
+	struct OutOfCoreOptions {
+		size_t memoryBudget{ size_t{ 256 } << 20 };  // Bytes of data held in memory at once.
+		std::filesystem::path scratchDirectory{};    // Directory of the scratch file. Empty selects the system temporary directory.
+	};
+
+	/**
+	 * Out-of-core 2D FFT. Same result as fft2D, the data is read and written a row at a time.
+	 * The scratch file is removed before returning.
+	 *
+	 * @height Number of rows.
+	 * @width Number of columns.
+	 * @readRow Callable as readRow(int row, std::complex<T>* points) to fill the width points of a row.
+	 * @writeRow Callable as writeRow(int row, const std::complex<T>* points) to take the width transformed points of a row. Rows come in order.
+	 * @is Direction of transform. Should be -1/1 (forward/inverse).
+	 * @options Memory budget and scratch directory.
+	 * @return False if the scratch file could not be created, its space reserved, or mapped.
+	 */
+	template <typename T>
+	bool fft2DOutOfCore(int height, int width,
+						const std::function<void(int, std::complex<T>*)>& readRow,
+						const std::function<void(int, const std::complex<T>*)>& writeRow,
+						int is,
+						const OutOfCoreOptions& options = {});
+
+	/**
+	 * Out-of-core rfft2D. Only the width/2+1 non-redundant columns of the spectrum are computed and stored.
+	 *
+	 * @readRow Callable as readRow(int row, T* points) to fill the width real points of a row.
+	 * @writeRow Callable as writeRow(int row, const std::complex<T>* spectrum) to take columns 0..width/2 of a spectrum row. Rows come in order.
+	 */
+	template <typename T>
+	bool rfft2DOutOfCore(int height, int width,
+						 const std::function<void(int, T*)>& readRow,
+						 const std::function<void(int, const std::complex<T>*)>& writeRow,
+						 int is,
+						 const OutOfCoreOptions& options = {});
+
+	/**
+	 * Out-of-core irfft2D. Unnormalized, the result is width*height times the original data.
+	 *
+	 * @readRow Callable as readRow(int row, std::complex<T>* spectrum) to fill columns 0..width/2 of a Hermitian spectrum row.
+	 * @writeRow Callable as writeRow(int row, const T* points) to take the width real points of a row. Rows come in order.
+	 */
+	template <typename T>
+	bool irfft2DOutOfCore(int height, int width,
+						  const std::function<void(int, std::complex<T>*)>& readRow,
+						  const std::function<void(int, const T*)>& writeRow,
+						  int is,
+						  const OutOfCoreOptions& options = {});
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include "Parallel.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FFT {
+
+	namespace {
+		std::atomic<int> threadCount{ 0 };
+
+		thread_local bool inParallelFor{ false };
+
+		// Worker threads, started on first use and kept until exit. One ParallelFor runs at a time,
+		// its chunks are taken in order by the calling thread and every worker that wakes for it.
+		class WorkerPool {
+		public:
+			static WorkerPool& Instance() {
+				static WorkerPool pool;
+				return pool;
+			}
+
+			~WorkerPool() {
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_stop = true;
+				}
+				m_wake.notify_all();
+				for (auto& worker : m_workers)
+					worker.join();
+			}
+
+			void Run(int count, int chunks, void (*call)(void*, int, int), void* context) {
+				std::lock_guard<std::mutex> submit(m_submitMutex);
+				while (static_cast<int>(m_workers.size()) < chunks - 1)
+					m_workers.emplace_back([this] { workerLoop(); });
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					// Workers that woke late for the previous job must be out of it before it is replaced.
+					m_done.wait(lock, [this] { return m_busy == 0; });
+					m_count = count;
+					m_chunks = chunks;
+					m_call = call;
+					m_context = context;
+					m_next = 0;
+					m_failed = false;
+					m_generation++;
+				}
+				m_wake.notify_all();
+
+				inParallelFor = true;
+				work();
+				inParallelFor = false;
+
+				// Every chunk has been taken, those taken by workers are done once no worker is busy.
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_done.wait(lock, [this] { return m_busy == 0; });
+				std::exception_ptr error{ std::move(m_error) };
+				m_error = nullptr;
+				lock.unlock();
+				if (error)
+					std::rethrow_exception(error);
+			}
+
+		private:
+			void work() {
+				for (int chunk{ m_next.fetch_add(1) }; chunk < m_chunks; chunk = m_next.fetch_add(1)) {
+					// Once a chunk has thrown, the rest are taken but skipped.
+					if (m_failed)
+						continue;
+					int begin{ static_cast<int>(static_cast<long long>(m_count) * chunk / m_chunks) };
+					int end{ static_cast<int>(static_cast<long long>(m_count) * (chunk + 1) / m_chunks) };
+					try {
+						m_call(m_context, begin, end);
+					}
+					catch (...) {
+						// Kept for Run to rethrow on the calling thread, the first one only.
+						std::lock_guard<std::mutex> lock(m_mutex);
+						if (!m_error)
+							m_error = std::current_exception();
+						m_failed = true;
+					}
+				}
+			}
+
+			void workerLoop() {
+				inParallelFor = true;
+				uint64_t seen{ 0 };
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (true) {
+					m_wake.wait(lock, [this, &seen] { return m_stop || m_generation != seen; });
+					if (m_stop)
+						return;
+					seen = m_generation;
+					m_busy++;
+					lock.unlock();
+					work();
+					lock.lock();
+					if (--m_busy == 0)
+						m_done.notify_all();
+				}
+			}
+
+			std::mutex m_submitMutex{};
+			std::vector<std::thread> m_workers{};
+
+			// The job fields are written under m_mutex while no worker is busy.
+			std::mutex m_mutex{};
+			std::condition_variable m_wake{};
+			std::condition_variable m_done{};
+			bool m_stop{ false };
+			uint64_t m_generation{ 0 };
+			int m_busy{ 0 };
+			int m_count{ 0 };
+			int m_chunks{ 0 };
+			void (*m_call)(void*, int, int) { nullptr };
+			void* m_context{ nullptr };
+			std::atomic<int> m_next{ 0 };
+			std::atomic<bool> m_failed{ false };
+			std::exception_ptr m_error{};       // Under m_mutex.
+		};
+	}
+
+	void SetThreadCount(int count) {
+		threadCount = std::max(count, 0);
+	}
+
+	int GetThreadCount() {
+		int count{ threadCount };
+		if (count == 0)
+			count = static_cast<int>(std::thread::hardware_concurrency());
+		return std::max(count, 1);
+	}
+
+	namespace Detail {
+
+		void RunChunks(int count, int chunks, void (*call)(void*, int, int), void* context) {
+			WorkerPool::Instance().Run(count, chunks, call, context);
+		}
+
+		bool InParallelFor() {
+			return inParallelFor;
+		}
+
+	}
+
+}
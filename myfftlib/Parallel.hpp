@@ -0,0 +1,61 @@
+#ifndef FFT_PARALLEL_HPP
+#define FFT_PARALLEL_HPP
+
+#include <algorithm>
+
+namespace FFT {
+
+	/**
+	 * Set number of worker threads used by parallel transforms.
+	 *
+	 * @count Thread count. 0 selects std::thread::hardware_concurrency().
+	 */
+	void SetThreadCount(int count);
+
+	/**
+	 * Number of worker threads used by parallel transforms, at least 1.
+	 */
+	int GetThreadCount();
+
+	namespace Detail {
+
+		/**
+		 * Run call(context, begin, end) for each of 'chunks' contiguous chunks of [0, count), on the
+		 * calling thread and the persistent worker pool. Returns once every chunk is done, or
+		 * rethrows the first exception a chunk threw once the running chunks are done.
+		 */
+		void RunChunks(int count, int chunks, void (*call)(void*, int, int), void* context);
+
+		/**
+		 * True while the calling thread runs a chunk of a ParallelFor.
+		 */
+		bool InParallelFor();
+
+	}
+
+	/**
+	 * Split [0, count) into contiguous chunks and process them on up to GetThreadCount() threads.
+	 * The chunks run on the calling thread and a pool of worker threads that is created once and
+	 * reused, so thread local scratch buffers of the workers persist between calls. A ParallelFor
+	 * called from inside a chunk runs inline on that thread instead of oversubscribing the cores.
+	 * If a chunk throws, the chunks not yet started are skipped and the exception is rethrown on
+	 * the calling thread once the running ones are done.
+	 *
+	 * @count Number of items.
+	 * @grain Minimum number of items worth a separate thread.
+	 * @func Callable as func(int begin, int end) for each chunk [begin, end).
+	 */
+	template <typename Func>
+	void ParallelFor(int count, int grain, Func func) {
+		int threads{ std::min(GetThreadCount(), (count + std::max(grain, 1) - 1) / std::max(grain, 1)) };
+		if (threads <= 1 || Detail::InParallelFor()) {
+			if (count > 0)
+				func(0, count);
+			return;
+		}
+		Detail::RunChunks(count, threads, [](void* context, int begin, int end) { (*static_cast<Func*>(context))(begin, end); }, &func);
+	}
+
+}
+
+#endif
@@ -0,0 +1,216 @@
+#include "PlanCache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace FFT {
+
+	namespace {
+
+		enum class PlanKind {
+			complexFloat,
+			complexDouble,
+			realFloat,
+			realDouble,
+		};
+
+		template <typename PlanType> constexpr PlanKind kindOf();
+		template <> constexpr PlanKind kindOf<Plan<float>>() { return PlanKind::complexFloat; }
+		template <> constexpr PlanKind kindOf<Plan<double>>() { return PlanKind::complexDouble; }
+		template <> constexpr PlanKind kindOf<RealPlan<float>>() { return PlanKind::realFloat; }
+		template <> constexpr PlanKind kindOf<RealPlan<double>>() { return PlanKind::realDouble; }
+
+		struct Entry {
+			int size{};
+			int is{};
+			PlanKind kind{};
+			std::shared_ptr<const void> plan{};
+			size_t bytes{};
+			// Tick of useClock at the latest use. Shared by all snapshots that hold the entry.
+			mutable std::atomic<uint64_t> lastUse{};
+		};
+
+		// Immutable once published, every change publishes a new table.
+		using Table = std::vector<std::shared_ptr<const Entry>>;
+
+		std::mutex cacheMutex;
+		std::shared_ptr<const Table> cacheTable{ std::make_shared<const Table>() }; // Guarded by cacheMutex.
+		std::atomic<uint64_t> cacheVersion{ 0 };
+		std::atomic<size_t> cacheLimit{ size_t{ 64 } << 20 };
+
+		// One tick per use of a plan other than the latest one used, so every entry has its own
+		// tick and the least recently used is exact. Repeated hits on the latest plan only read it.
+		std::atomic<uint64_t> useClock{ 0 };
+		std::atomic<uint64_t> missCount{ 0 };
+		std::atomic<uint64_t> evictionCount{ 0 };
+
+		// Hits are counted per thread, so that hits on different threads do not write to a shared
+		// cache line. GetPlanCacheStats sums the counters, those of exited threads are kept in retiredHits.
+		struct alignas(64) HitCounter {
+			std::atomic<uint64_t> hits{ 0 };
+			HitCounter();
+			~HitCounter();
+		};
+
+		std::mutex counterMutex;
+		std::vector<const HitCounter*> hitCounters{};  // Guarded by counterMutex.
+		uint64_t retiredHits{ 0 };                     // Guarded by counterMutex.
+
+		HitCounter::HitCounter() {
+			std::lock_guard<std::mutex> lock(counterMutex);
+			hitCounters.push_back(this);
+		}
+
+		HitCounter::~HitCounter() {
+			std::lock_guard<std::mutex> lock(counterMutex);
+			retiredHits += hits.load(std::memory_order_relaxed);
+			hitCounters.erase(std::find(hitCounters.begin(), hitCounters.end(), this));
+		}
+
+		thread_local HitCounter threadHits;
+
+		uint64_t hitCount() {
+			std::lock_guard<std::mutex> lock(counterMutex);
+			uint64_t hits{ retiredHits };
+			for (const HitCounter* counter : hitCounters)
+				hits += counter->hits.load(std::memory_order_relaxed);
+			return hits;
+		}
+
+		void touch(const Entry& entry) {
+			if (entry.lastUse.load(std::memory_order_relaxed) != useClock.load(std::memory_order_relaxed))
+				entry.lastUse.store(useClock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		struct Snapshot {
+			uint64_t version{ UINT64_MAX };
+			std::shared_ptr<const Table> table{};
+		};
+
+		thread_local Snapshot threadSnapshot;
+
+		size_t tableBytes(const Table& table) {
+			size_t bytes{ 0 };
+			for (auto& entry : table)
+				bytes += entry->bytes;
+			return bytes;
+		}
+
+		// Drop least recently used entries, except keep, until the table fits the limit. Call with cacheMutex held.
+		void evict(Table& table, const Entry* keep) {
+			size_t bytes{ tableBytes(table) };
+			const size_t limit{ cacheLimit.load() };
+			while (bytes > limit) {
+				auto victim{ table.end() };
+				for (auto entry{ table.begin() }; entry != table.end(); ++entry) {
+					if (entry->get() != keep && (victim == table.end() || (*entry)->lastUse < (*victim)->lastUse))
+						victim = entry;
+				}
+				if (victim == table.end())
+					break;
+				bytes -= (*victim)->bytes;
+				table.erase(victim);
+				evictionCount++;
+			}
+		}
+
+		// Publish a new table. Call with cacheMutex held.
+		void publish(std::shared_ptr<const Table> table) {
+			cacheTable = std::move(table);
+			threadSnapshot = { ++cacheVersion, cacheTable };
+		}
+
+		const Entry* find(const Table& table, int size, int is, PlanKind kind) {
+			for (auto& entry : table) {
+				if (entry->size == size && entry->is == is && entry->kind == kind)
+					return entry.get();
+			}
+			return nullptr;
+		}
+
+		template <typename PlanType>
+		std::shared_ptr<const PlanType> getCached(int size, int is) {
+			constexpr PlanKind kind{ kindOf<PlanType>() };
+			if (threadSnapshot.version != cacheVersion.load(std::memory_order_acquire)) {
+				std::lock_guard<std::mutex> lock(cacheMutex);
+				threadSnapshot = { cacheVersion.load(), cacheTable };
+			}
+
+			if (const Entry* entry{ find(*threadSnapshot.table, size, is, kind) }) {
+				touch(*entry);
+				// Only this thread writes its counter, a plain load and store is enough.
+				threadHits.hits.store(threadHits.hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return std::static_pointer_cast<const PlanType>(entry->plan);
+			}
+
+			// Build outside the lock, other threads keep hitting meanwhile.
+			missCount++;
+			auto plan{ std::make_shared<const PlanType>(size, is) };
+
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			if (const Entry* entry{ find(*cacheTable, size, is, kind) }) {
+				// Another thread built the same plan first.
+				touch(*entry);
+				threadSnapshot = { cacheVersion.load(), cacheTable };
+				return std::static_pointer_cast<const PlanType>(entry->plan);
+			}
+			auto entry{ std::make_shared<Entry>() };
+			entry->size = size;
+			entry->is = is;
+			entry->kind = kind;
+			entry->plan = plan;
+			entry->bytes = plan->MemorySize();
+			entry->lastUse = ++useClock;
+			auto table{ std::make_shared<Table>(*cacheTable) };
+			table->push_back(entry);
+			evict(*table, entry.get());
+			publish(std::move(table));
+			return plan;
+		}
+
+	}
+
+	template <typename T>
+	std::shared_ptr<const Plan<T>> GetPlan(int size, int is) {
+		return getCached<Plan<T>>(size, is);
+	}
+
+	template <typename T>
+	std::shared_ptr<const RealPlan<T>> GetRealPlan(int size, int is) {
+		return getCached<RealPlan<T>>(size, is);
+	}
+
+	PlanCacheStats GetPlanCacheStats() {
+		std::shared_ptr<const Table> table{};
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			table = cacheTable;
+		}
+		return { hitCount(), missCount.load(), evictionCount.load(), table->size(), tableBytes(*table) };
+	}
+
+	void SetPlanCacheLimit(size_t bytes) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		cacheLimit = bytes;
+		auto table{ std::make_shared<Table>(*cacheTable) };
+		const Entry* newest{ nullptr };
+		for (auto& entry : *table) {
+			if (newest == nullptr || entry->lastUse > newest->lastUse)
+				newest = entry.get();
+		}
+		evict(*table, newest);
+		publish(std::move(table));
+	}
+
+	void ClearPlanCache() {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		publish(std::make_shared<const Table>());
+	}
+
+	template std::shared_ptr<const Plan<float>> GetPlan(int, int);
+	template std::shared_ptr<const Plan<double>> GetPlan(int, int);
+	template std::shared_ptr<const RealPlan<float>> GetRealPlan(int, int);
+	template std::shared_ptr<const RealPlan<double>> GetRealPlan(int, int);
+
+}
@@ -0,0 +1,53 @@
+#ifndef FFT_PLAN_CACHE_HPP
+#define FFT_PLAN_CACHE_HPP
+
+#include "FFT.hpp"
+#include <cstdint>
+#include <memory>
+
+namespace FFT {
+
+	/**
+	 * Shared plan for a size, direction and precision. Built on first use and kept in a process-wide cache.
+	 *
+	 * Safe to call from any thread. A hit reads an atomic version number and searches a per-thread
+	 * snapshot of the cache, without taking a lock, and counts itself in a per-thread counter. Only
+	 * a hit on another plan than the latest one used advances the shared use clock. A miss builds
+	 * the plan, then publishes a new snapshot under a lock and evicts least recently used plans
+	 * beyond the memory limit.
+	 *
+	 * @size Transform size.
+	 * @is Direction of transform. Should be -1/1 (forward/inverse).
+	 */
+	template <typename T = double>
+	std::shared_ptr<const Plan<T>> GetPlan(int size, int is);
+
+	template <typename T = double>
+	std::shared_ptr<const RealPlan<T>> GetRealPlan(int size, int is);
+
+	struct PlanCacheStats {
+		uint64_t hits{};
+		uint64_t misses{};
+		uint64_t evictions{};
+		size_t plans{};         // Plans currently cached.
+		size_t bytes{};         // Memory held by the cached plans, see Plan::MemorySize().
+	};
+
+	PlanCacheStats GetPlanCacheStats();
+
+	/**
+	 * Limit memory held by cached plans. Plans still in use elsewhere stay alive after eviction,
+	 * so do plans referenced by an outdated snapshot until its thread next uses the cache.
+	 *
+	 * @bytes Memory limit. The most recently used plan is kept even if it alone exceeds the limit.
+	 */
+	void SetPlanCacheLimit(size_t bytes);
+
+	/**
+	 * Drop all cached plans. Counters are kept.
+	 */
+	void ClearPlanCache();
+
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include "BufferPool.hpp"
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <new>
+
+namespace Image {
+
+    BufferPool::~BufferPool() {
+        Trim();
+    }
+
+    void* BufferPool::Acquire(size_t bytes, size_t& capacity) {
+        capacity = bucketSize(bytes);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it{ m_free.find(capacity) };
+            if (it != m_free.end()) {
+                void* buffer{ it->second };
+                m_free.erase(it);
+                m_stats.bytesRetained -= capacity;
+                m_stats.bytesReused += capacity;
+                m_stats.reuseCount++;
+                return buffer;
+            }
+            m_stats.bytesAllocated += capacity;
+            m_stats.allocationCount++;
+        }
+        return ::operator new(capacity, std::align_val_t{ Alignment });
+    }
+
+    void BufferPool::Release(void* buffer, size_t capacity) {
+        if (buffer == nullptr)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stats.bytesRetained + capacity <= m_maxRetainedBytes) {
+                m_free.emplace(capacity, buffer);
+                m_stats.bytesRetained += capacity;
+                return;
+            }
+        }
+        ::operator delete(buffer, std::align_val_t{ Alignment });
+    }
+
+    void BufferPool::Trim() {
+        trimTo(0);
+    }
+
+    void BufferPool::SetMaxRetainedBytes(size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_maxRetainedBytes = bytes;
+        }
+        trimTo(bytes);
+    }
+
+    BufferPool::Stats BufferPool::GetStats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    size_t BufferPool::bucketSize(size_t bytes) {
+        // Quarter steps between powers of two waste at most a fifth of a buffer.
+        if (bytes <= Alignment)
+            return Alignment;
+        size_t power{ std::bit_floor(bytes) };
+        size_t step{ std::max(power / 4, Alignment) };
+        return (bytes + step - 1) / step * step;
+    }
+
+    void BufferPool::trimTo(size_t bytes) {
+        // Largest buffers are freed first.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (m_stats.bytesRetained > bytes && !m_free.empty()) {
+            auto it{ std::prev(m_free.end()) };
+            ::operator delete(it->second, std::align_val_t{ Alignment });
+            m_stats.bytesRetained -= it->first;
+            m_free.erase(it);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+namespace Image {
+
+    /**
+    * Pool of 64-byte aligned buffers, recycled by size. Requests are rounded up to a size bucket
+    * (1, 1.25, 1.5 or 1.75 times a power of two), so buffers of nearly the same size are shared.
+    * Released buffers are kept for reuse up to a limit, then freed. Thread safe.
+    */
+    class BufferPool {
+    public:
+        static constexpr size_t Alignment{ 64 };
+
+        struct Stats {
+            size_t bytesReused{};       // Bytes handed out from released buffers.
+            size_t bytesAllocated{};    // Bytes newly allocated from the system.
+            size_t reuseCount{};        // Number of requests served from released buffers.
+            size_t allocationCount{};   // Number of requests that allocated.
+            size_t bytesRetained{};     // Bytes currently held for reuse.
+        };
+
+        explicit BufferPool(size_t maxRetainedBytes = size_t{ 256 } << 20) : m_maxRetainedBytes{ maxRetainedBytes } {};
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+        ~BufferPool();
+
+        /**
+        * Buffer of at least 'bytes' bytes. 'capacity' is set to its actual size, to be passed back to Release.
+        */
+        void* Acquire(size_t bytes, size_t& capacity);
+
+        /**
+        * Return a buffer from Acquire. It is kept for reuse unless that exceeds the retained bytes limit.
+        */
+        void Release(void* buffer, size_t capacity);
+
+        /**
+        * Free all buffers held for reuse.
+        */
+        void Trim();
+
+        void SetMaxRetainedBytes(size_t bytes);
+        Stats GetStats() const;
+
+    private:
+        static size_t bucketSize(size_t bytes);
+        void trimTo(size_t bytes);
+
+        mutable std::mutex m_mutex{};
+        std::multimap<size_t, void*> m_free{};
+        size_t m_maxRetainedBytes{};
+        Stats m_stats{};
+    };
+}
@@ -1,15 +1,26 @@
 #pragma once
+#include "Matrix.hpp"
+#include <array>
 #include <vector>
 #include <complex>
 #include <string_view>
 
 namespace Image {
 
-    using mat = std::vector<std::vector<double>>;
-    using matComplex = std::vector<std::vector<std::complex<double>>>;
+    using mat = Matrix<double>;
+    using matComplex = Matrix<std::complex<double>>;
+    using sharedMat = SharedMatrix<double>;
+    using sharedMatComplex = SharedMatrix<std::complex<double>>;
 
-    using matRgb = std::vector<std::vector<double[3]>>;
-    using matComplexRgb = std::vector<std::vector<std::complex<double>[3]>>;
+    // Single precision, for the results of float transforms.
+    using matFloat = Matrix<float>;
+    using matComplexFloat = Matrix<std::complex<float>>;
+
+    // Planar colour images: red, green and blue planes of the same size.
+    using matRgb = std::array<mat, 3>;
+    using matComplexRgb = std::array<matComplex, 3>;
+    using rgbView = std::array<MatrixView<const double>, 3>;
+    using complexRgbView = std::array<MatrixView<const std::complex<double>>, 3>;
 
 
     enum class ResultCode {
@@ -21,39 +32,106 @@ namespace Image {
 
     class ILoader {
     public:
+        virtual ~ILoader() {};
         virtual ResultCode LoadFromFile(std::string path) = 0;
         virtual ResultCode SaveAsFile(std::string path) = 0;
     };
 
     class IResetter {
     public:
+        virtual ~IResetter() {};
         virtual ResultCode Reset() = 0;
     };
 
     class IRealGrayImage {
     public:
+        virtual ~IRealGrayImage() {};
         virtual ResultCode GetGrayImageMat(mat& mat) = 0;
         virtual ResultCode SetGrayImageMat(const mat& mat) = 0;
+
+        /**
+        * Read-only view of the stored matrix, without copying. Valid until the image is next set, taken or reset.
+        */
+        virtual ResultCode GetGrayImageView(MatrixView<const double>& view) const = 0;
+
+        /**
+        * Store 'mat' without copying. 'mat' is left empty.
+        */
+        virtual ResultCode SetGrayImageMat(mat&& mat) = 0;
+
+        /**
+        * Move the stored matrix out into 'mat', without copying. The image is left empty.
+        */
+        virtual ResultCode TakeGrayImageMat(mat& mat) = 0;
+
+        /**
+        * Shared, copy-on-write handle to the stored matrix. Images set from it share its buffer
+        * until one of them is modified.
+        */
+        virtual ResultCode GetGrayImageShared(sharedMat& shared) const = 0;
+        virtual ResultCode SetGrayImageShared(const sharedMat& shared) = 0;
+
+        /**
+        * Single precision storage. The image holds one precision at a time, the view of the
+        * other is empty and so are the double matrices above while a float one is stored.
+        */
+        virtual ResultCode GetGrayImageView(MatrixView<const float>& view) const = 0;
+        virtual ResultCode SetGrayImageMat(matFloat&& mat) = 0;
     };
 
 
     class IComplexGrayImage {
     public:
+        virtual ~IComplexGrayImage() {};
         virtual ResultCode GetGrayImageComplexMat(matComplex& mat) = 0;
         virtual ResultCode SetGrayImageComplexMat(const matComplex& mat) = 0;
+        virtual ResultCode GetGrayImageComplexView(MatrixView<const std::complex<double>>& view) const = 0;
+        virtual ResultCode SetGrayImageComplexMat(matComplex&& mat) = 0;
+        virtual ResultCode TakeGrayImageComplexMat(matComplex& mat) = 0;
+        virtual ResultCode GetGrayImageComplexShared(sharedMatComplex& shared) const = 0;
+        virtual ResultCode SetGrayImageComplexShared(const sharedMatComplex& shared) = 0;
+    };
+
+    /**
+    * Spectrum of a real image of 'width' columns, kept as its non-redundant half: columns 0 to
+    * width / 2 of the transform, in transform order. The rest follow from X[i][j] = conj(X[-i][-j]).
+    * It is held in one precision at a time, the view of the other is empty. 'width' is that of
+    * the spectrum held in either, 0 when empty.
+    */
+    class IHalfSpectrumImage {
+    public:
+        virtual ~IHalfSpectrumImage() {};
+        virtual ResultCode GetHalfSpectrumView(MatrixView<const std::complex<double>>& view, int& width) const = 0;
+        virtual ResultCode GetHalfSpectrumView(MatrixView<const std::complex<float>>& view, int& width) const = 0;
+        virtual ResultCode SetHalfSpectrum(matComplex&& mat, int width) = 0;
+        virtual ResultCode SetHalfSpectrum(matComplexFloat&& mat, int width) = 0;
     };
 
     class IRealRgbImage {
     public:
+        virtual ~IRealRgbImage() {};
         virtual ResultCode GetRgbImageMat(matRgb& mat) = 0;
         virtual ResultCode SetRgbImageMat(const matRgb& mat) = 0;
+
+        /**
+        * Read-only views of the stored planes, without copying. Valid until the image is next set or reset.
+        */
+        virtual ResultCode GetRgbImageView(rgbView& view) const = 0;
+
+        /**
+        * Store the planes of 'mat' without copying. 'mat' is left empty.
+        */
+        virtual ResultCode SetRgbImageMat(matRgb&& mat) = 0;
     };
 
 
     class IComplexRgbImage {
     public:
+        virtual ~IComplexRgbImage() {};
         virtual ResultCode GetRgbImageComplexMat(matComplexRgb& mat) = 0;
         virtual ResultCode SetRgbImageComplexMat(const matComplexRgb& mat) = 0;
+        virtual ResultCode GetRgbImageComplexView(complexRgbView& view) const = 0;
+        virtual ResultCode SetRgbImageComplexMat(matComplexRgb&& mat) = 0;
     };
 
 
@@ -1,49 +1,65 @@
 #include "ImageFilter.hpp"
+#include "MappedImage.hpp"
 #include "FFT.hpp"
+#include "OutOfCore.hpp"
 #include <cmath>
 #include <algorithm>
 #include <random>
+#include <type_traits>
+#include <vector>
 
 
 ImageFilter::ImageFilter() {
-    originalImg = std::make_unique<Image::RealGrayImageWx>();
-    resizedImg = std::make_unique<Image::RealGrayImageWx>();
-    noisyImg = std::make_unique<Image::RealGrayImageWx>();
-    imgDFT = std::make_unique<Image::ComplexGrayImageWx>();
-    imgDFTMasked = std::make_unique<Image::ComplexGrayImageWx>();
-    processedImg = std::make_unique<Image::RealGrayImageWx>();
+    originalImg = std::make_unique<Image::RealGrayImageWx>(bufferPool);
+    resizedImg = std::make_unique<Image::RealGrayImageWx>(bufferPool);
+    noisyImg = std::make_unique<Image::RealGrayImageWx>(bufferPool);
+    imgDFT = std::make_unique<Image::HalfSpectrumImageWx>(bufferPool);
+    imgDFTMasked = std::make_unique<Image::HalfSpectrumImageWx>(bufferPool);
+    processedImg = std::make_unique<Image::RealGrayImageWx>(bufferPool);
+    rgbImg = std::make_unique<Image::RealRgbImageWx>(bufferPool);
+    processedRgbImg = std::make_unique<Image::RealRgbImageWx>(bufferPool);
 }
 
 void ImageFilter::LoadFromFile(std::string path) {
     using namespace Image;
-    originalImg->LoadFromFile(path);
-    mat origMat{};
-    originalImg->GetGrayImageMat(origMat);
-    resizedImg->SetGrayImageMat(origMat);
-    noisyImg->SetGrayImageMat(origMat);
-    imgDFT->Reset();
-    imgDFTMasked->Reset();
-    processedImg->Reset();
+    // Raw sample formats are mapped and read at full precision, the rest are decoded through wx.
+    ResultCode result{ MappedGrayLoader::Supports(path) ? MappedGrayLoader(*originalImg, bufferPool).LoadFromFile(path)
+                                                         : originalImg->LoadFromFile(path) };
+    if (result != ResultCode::ok)
+        return;
+    // The three stages share one buffer until one of them is modified.
+    sharedMat origMat{};
+    originalImg->GetGrayImageShared(origMat);
+    resizedImg->SetGrayImageShared(origMat);
+    noisyImg->SetGrayImageShared(origMat);
+    noiseApplied = false;
+    stageChanged(Stage::original);
+    stageChanged(Stage::resized);
+    stageChanged(Stage::noisy);
+    resetStage(Stage::dft);
+    resetStage(Stage::maskedDft);
+    resetStage(Stage::processed);
+    enforceStageMemoryBudget();
     // TODO: notify mediator of "LoadFromFile" event
 }
 
 void ImageFilter::ResizeImage(int width, int height, ResizeMode mode) {
     using namespace Image;
-    mat oldMat{};
-    originalImg->GetGrayImageMat(oldMat);
-    if (width <= 0 || height <= 0 || oldMat.size() == 0 || oldMat[0].size() == 0)
+    MatrixView<const double> oldMat{};
+    originalImg->GetGrayImageView(oldMat);
+    if (width <= 0 || height <= 0 || oldMat.Empty())
         return;
-    mat resizedMat(height, std::vector<double>(width, 0.0));
+    mat resizedMat(bufferPool, height, width, 0.0);
     
 
-    double dx { (static_cast<double>(oldMat[0].size()) - 1.0) / static_cast<double>(width) };
-    double dy { (static_cast<double>(oldMat.size()) - 1.0) / static_cast<double>(height) };
+    double dx { (static_cast<double>(oldMat.Width()) - 1.0) / static_cast<double>(width) };
+    double dy { (static_cast<double>(oldMat.Height()) - 1.0) / static_cast<double>(height) };
 
     switch (mode) {
         case ResizeMode::zeroPadding: {
             for (int i = 0; i < width; i++) {
                 for (int j = 0; j < height; j++) {
-                    resizedMat[j][i] = ((j < oldMat.size()) && (i < oldMat[0].size())) ? oldMat[j][i] : 0;
+                    resizedMat[j][i] = ((j < oldMat.Height()) && (i < oldMat.Width())) ? oldMat[j][i] : 0;
                 }
             }
             break;
@@ -79,29 +95,124 @@ void ImageFilter::ResizeImage(int width, int height, ResizeMode mode) {
     }
 
     //originalImg->SetGrayImageMat(resizedMat);
-    resizedImg->SetGrayImageMat(resizedMat);
-    noisyImg->SetGrayImageMat(resizedMat);
-    imgDFT->Reset();
-    imgDFTMasked->Reset();
-    processedImg->Reset();
+    sharedMat sharedResizedMat{ std::move(resizedMat) };
+    resizedImg->SetGrayImageShared(sharedResizedMat);
+    noisyImg->SetGrayImageShared(sharedResizedMat);
+    noiseApplied = false;
+    stageChanged(Stage::resized);
+    stageChanged(Stage::noisy);
+    resetStage(Stage::dft);
+    resetStage(Stage::maskedDft);
+    resetStage(Stage::processed);
+    enforceStageMemoryBudget();
     // TODO: notify mediator of "ResizedImage" event
 }
 
 void ImageFilter::AddNoise(double percent) {
     using namespace Image;
-    mat resizedMat{};
-    resizedImg->GetGrayImageMat(resizedMat);
-    if (resizedMat.size() == 0 || resizedMat[0].size() == 0)
+    MatrixView<const double> resizedMat{};
+    resizedImg->GetGrayImageView(resizedMat);
+    if (resizedMat.Empty())
         return;
-    int height{ static_cast<int>(resizedMat.size()) };
-    int width{ static_cast<int>(resizedMat[0].size()) };
+    noiseApplied = true;
+    noisePercent = percent;
+    noiseSeed = std::random_device{}();
+    noisyImg->SetGrayImageMat(computeNoisy());
+    stageChanged(Stage::noisy);
+    resetStage(Stage::dft);
+    resetStage(Stage::maskedDft);
+    resetStage(Stage::processed);
+    enforceStageMemoryBudget();
+}
+
+void ImageFilter::ComputeFourierTransform() {
+    using namespace Image;
+    restoreStage(Stage::noisy);
+    MatrixView<const double> noisyMat{};
+    noisyImg->GetGrayImageView(noisyMat);
+    if (noisyMat.Empty())
+        return;
+    dftPrecision = precision;
+    computeDFT(dftPrecision);
+    stageChanged(Stage::dft);
+    resetStage(Stage::maskedDft);
+    resetStage(Stage::processed);
+    enforceStageMemoryBudget();
+}
+
+void ImageFilter::ApplyFilterMask(double maskSize, FilterPassMode pass) {
+    using namespace Image;
+    restoreStage(Stage::dft);
+    // The width is set for a spectrum of either precision.
+    MatrixView<const std::complex<double>> dftMat{};
+    int width{};
+    imgDFT->GetHalfSpectrumView(dftMat, width);
+    if (width == 0)
+        return;
+    appliedMaskSize = maskSize;
+    appliedMaskPass = pass;
+    computeMasked(*imgDFTMasked, appliedMaskSize, appliedMaskPass);
+    stageChanged(Stage::maskedDft);
+    enforceStageMemoryBudget();
+}
+
+void ImageFilter::ComputeInverseFourierTransform() {
+    using namespace Image;
+    restoreStage(Stage::maskedDft);
+    MatrixView<const std::complex<double>> dftMat{};
+    int width{};
+    imgDFTMasked->GetHalfSpectrumView(dftMat, width);
+ 
+    if (width == 0)
+        return;
+    processedPrecision = precision;
+    processedMaskSize = appliedMaskSize;
+    processedMaskPass = appliedMaskPass;
+    computeProcessed(*imgDFTMasked, processedPrecision);
+    stageChanged(Stage::processed);
+    enforceStageMemoryBudget();
+}
+
+Image::ResultCode ImageFilter::LoadRgbFromFile(std::string path) {
+    using namespace Image;
+    // The raw sample formats are gray frames, there are no colour planes to load.
+    if (MappedGrayLoader::Supports(path))
+        return ResultCode::invalidInput;
+    ResultCode result{ rgbImg->LoadFromFile(path) };
+    if (result != ResultCode::ok)
+        return result;
+    stageChanged(Stage::rgb);
+    resetStage(Stage::processedRgb);
+    enforceStageMemoryBudget();
+    return result;
+}
+
+void ImageFilter::ApplyRgbFilterMask(double maskSize, FilterPassMode pass) {
+    Image::rgbView planes{};
+    rgbImg->GetRgbImageView(planes);
+    if (planes[0].Empty())
+        return;
+    rgbPrecision = precision;
+    rgbMaskSize = maskSize;
+    rgbMaskPass = pass;
+    processedRgbImg->SetRgbImageMat(computeProcessedRgb(rgbPrecision, rgbMaskSize, rgbMaskPass));
+    stageChanged(Stage::processedRgb);
+    enforceStageMemoryBudget();
+}
+
+Image::mat ImageFilter::computeNoisy() {
+    // Seeded with noiseSeed, so a dropped noisy image comes back the same.
+    using namespace Image;
+    MatrixView<const double> resizedMat{};
+    resizedImg->GetGrayImageView(resizedMat);
+    int height{ resizedMat.Height() };
+    int width{ resizedMat.Width() };
 
-    mat noiseMat(height, std::vector<double>(width, 0.0));
-    mat noisedImgMat(height, std::vector<double>(width, 0.0));
+    mat noiseMat(bufferPool, height, width, 0.0);
+    mat noisedImgMat(bufferPool, height, width, 0.0);
 
     // Sample normal distribution
-    std::random_device rd{};
-    std::mt19937 gen{ rd() };
+    std::mt19937 gen{ noiseSeed };
     std::normal_distribution<double> nd(0, 1);
 
     auto nd_sample{ [&nd, &gen] { return nd(gen); } };
@@ -124,7 +235,7 @@ void ImageFilter::AddNoise(double percent) {
         }
     }
 
-    noiseScalingFactor = sqrt((percent / 100.0) * signalEnergy / noiseEnergy);
+    noiseScalingFactor = sqrt((noisePercent / 100.0) * signalEnergy / noiseEnergy);
 
     // Apply additive noise to the image.
     for (int i = 0; i < height; i++) {
@@ -133,223 +244,598 @@ void ImageFilter::AddNoise(double percent) {
         }
     }
 
-    noisyImg->SetGrayImageMat(noisedImgMat);
-    imgDFT->Reset();
-    imgDFTMasked->Reset();
-    processedImg->Reset();
+    return noisedImgMat;
 }
 
-void ImageFilter::ComputeFourierTransform() {
+void ImageFilter::computeDFT(TransformPrecision transformPrecision) {
     using namespace Image;
-    matComplex dftMat{};
-    mat noisyMat{};
-    noisyImg->GetGrayImageMat(noisyMat);
-    if (noisyMat.size() == 0 || noisyMat[0].size() == 0)
-        return;
-
-    dftMat = matComplex(noisyMat.size(), std::vector<std::complex<double>>(noisyMat[0].size(), { 0, 0 }));
-    
-    for (int i = 0; i < noisyMat.size(); i++) {
-        for (int j = 0; j < noisyMat[0].size(); j++) {
-            dftMat[i][j] = std::complex<double>(noisyMat[i][j], 0);
+    MatrixView<const double> noisyMat{};
+    noisyImg->GetGrayImageView(noisyMat);
+    switch (transformPrecision) {
+        case TransformPrecision::float64: {
+            imgDFT->SetHalfSpectrum(forwardTransform<double>(noisyMat), noisyMat.Width());
+            break;
+        }
+        case TransformPrecision::float32: {
+            imgDFT->SetHalfSpectrum(forwardTransform<float>(noisyMat), noisyMat.Width());
+            break;
         }
     }
-
-    FFT::fft2D(dftMat, 1);
-    dftMat = fftShift(dftMat);
-    imgDFT->SetGrayImageComplexMat(dftMat);
-    imgDFTMasked->Reset();
-    processedImg->Reset();
 }
 
-void ImageFilter::ApplyFilterMask(double maskSize, FilterPassMode pass) {
+void ImageFilter::computeMasked(Image::IHalfSpectrumImage& maskedImg, double maskSize, FilterPassMode pass) {
     using namespace Image;
-    matComplex dftMat{};
-    matComplex maskedMat{};
-    imgDFT->GetGrayImageComplexMat(dftMat);
-    if (dftMat.size() == 0 || dftMat[0].size() == 0)
-        return;
-    maskedMat = matComplex(dftMat.size(), std::vector<std::complex<double>>(dftMat[0].size(), { 0, 0 }));
-    int height{ static_cast<int>(dftMat.size()) };
-    int width{ static_cast<int>(dftMat[0].size()) };
-    int size{ static_cast<int>(std::sqrt(static_cast<double>(height) * static_cast<double>(height) +
-                                         static_cast<double>(width) * static_cast<double>(width)) * maskSize / 2.0) };
-    mat mask{ generateMask(width, height, size, pass) };
-    for (int i = 0; i < dftMat.size(); i++) 
-        for (int j = 0; j < dftMat[0].size(); j++) 
-            maskedMat[i][j] = dftMat[i][j] * mask[i][j];
-    
-    imgDFTMasked->SetGrayImageComplexMat(maskedMat);
+    MatrixView<const std::complex<double>> dftMat{};
+    MatrixView<const std::complex<float>> dftMatFloat{};
+    int width{};
+    imgDFT->GetHalfSpectrumView(dftMat, width);
+    imgDFT->GetHalfSpectrumView(dftMatFloat, width);
+    int height{ std::max(dftMat.Height(), dftMatFloat.Height()) };
+    mat mask{ naturalOrderMask(width, height, maskSize, pass) };
+    if (dftMatFloat.Empty())
+        maskedImg.SetHalfSpectrum(applyMask(dftMat, mask), width);
+    else
+        maskedImg.SetHalfSpectrum(applyMask(dftMatFloat, mask), width);
 }
 
-void ImageFilter::ComputeInverseFourierTransform() {
+void ImageFilter::computeProcessed(const Image::IHalfSpectrumImage& maskedImg, TransformPrecision transformPrecision) {
+    // The masked spectrum may be in the other precision, it is converted while copied for the transform.
     using namespace Image;
-    matComplex dftMat{};
-    matComplex idftMat{};
-    imgDFTMasked->GetGrayImageComplexMat(dftMat);
- 
-    if (dftMat.size() == 0 || dftMat[0].size() == 0)
-        return;
+    MatrixView<const std::complex<double>> maskedMat{};
+    MatrixView<const std::complex<float>> maskedMatFloat{};
+    int width{};
+    maskedImg.GetHalfSpectrumView(maskedMat, width);
+    maskedImg.GetHalfSpectrumView(maskedMatFloat, width);
+    switch (transformPrecision) {
+        case TransformPrecision::float64: {
+            processedImg->SetGrayImageMat(maskedMatFloat.Empty() ? inverseTransform<double>(maskedMat, width)
+                                                                 : inverseTransform<double>(maskedMatFloat, width));
+            break;
+        }
+        case TransformPrecision::float32: {
+            processedImg->SetGrayImageMat(maskedMatFloat.Empty() ? inverseTransform<float>(maskedMat, width)
+                                                                 : inverseTransform<float>(maskedMatFloat, width));
+            break;
+        }
+    }
+}
+
+Image::matRgb ImageFilter::computeProcessedRgb(TransformPrecision transformPrecision, double maskSize, FilterPassMode pass) {
+    Image::rgbView planes{};
+    rgbImg->GetRgbImageView(planes);
+    switch (transformPrecision) {
+        case TransformPrecision::float64:
+            return filterRgb<double>(planes, maskSize, pass);
+        case TransformPrecision::float32:
+            return filterRgb<float>(planes, maskSize, pass);
+    }
+    return {};
+}
 
-    dftMat = ifftShift(dftMat);
-    idftMat = matComplex(dftMat.size(), std::vector<std::complex<double>>(dftMat[0].size(), { 0, 0 }));
+void ImageFilter::SetTransformPrecision(TransformPrecision newPrecision) {
+    precision = newPrecision;
+}
 
-    for (int i = 0; i < dftMat.size(); i++) {
-        for (int j = 0; j < dftMat[0].size(); j++) {
-            idftMat[i][j] = dftMat[i][j];
+void ImageFilter::SetMemoryBudget(size_t bytes, std::string scratchDirectory) {
+    memoryBudget = bytes;
+    this->scratchDirectory = scratchDirectory;
+}
+
+void ImageFilter::SetStageMemoryBudget(size_t bytes) {
+    stageMemoryBudget = bytes;
+    enforceStageMemoryBudget();
+}
+
+ImageFilter::StageMemoryReport ImageFilter::GetStageMemoryReport() const {
+    StageMemoryReport report{};
+    report.budget = stageMemoryBudget;
+    report.droppedStages = droppedStages;
+    std::vector<const void*> buffers{};
+    for (size_t stage = 0; stage < stageCount; stage++) {
+        const void* data{ nullptr };
+        report.stageBytes[stage] = stageBytes(static_cast<Stage>(stage), data);
+        // Stages sharing a buffer are counted once in the total.
+        if (data != nullptr && std::find(buffers.begin(), buffers.end(), data) == buffers.end()) {
+            buffers.push_back(data);
+            report.residentBytes += report.stageBytes[stage];
         }
     }
+    report.cacheBytes = imgDFT->GetCacheBytes() + imgDFTMasked->GetCacheBytes();
+    for (const auto& stageCache : bitmapCache) {
+        for (const CachedBitmap& cached : stageCache) {
+            // 24-bit bitmaps, 3 bytes per pixel.
+            if (cached.valid)
+                report.cacheBytes += 3 * static_cast<size_t>(cached.bitmap.GetWidth()) * cached.bitmap.GetHeight();
+        }
+    }
+    report.residentBytes += report.cacheBytes;
+    report.pooledBytes = bufferPool.GetStats().bytesRetained;
+    return report;
+}
 
-    FFT::fft2D(idftMat, -1);
+size_t ImageFilter::stageBytes(Stage stage, const void*& data) const {
+    using namespace Image;
+    MatrixView<const double> realView{};
+    MatrixView<const float> floatView{};
+    MatrixView<const std::complex<double>> complexView{};
+    MatrixView<const std::complex<float>> complexFloatView{};
+    rgbView planes{};
+    int width{};
+    switch (stage) {
+        case Stage::original: {
+            originalImg->GetGrayImageView(realView);
+            break;
+        }
+        case Stage::resized: {
+            resizedImg->GetGrayImageView(realView);
+            break;
+        }
+        case Stage::noisy: {
+            noisyImg->GetGrayImageView(realView);
+            break;
+        }
+        case Stage::dft: {
+            imgDFT->GetHalfSpectrumView(complexView, width);
+            imgDFT->GetHalfSpectrumView(complexFloatView, width);
+            break;
+        }
+        case Stage::maskedDft: {
+            imgDFTMasked->GetHalfSpectrumView(complexView, width);
+            imgDFTMasked->GetHalfSpectrumView(complexFloatView, width);
+            break;
+        }
+        case Stage::processed: {
+            processedImg->GetGrayImageView(realView);
+            processedImg->GetGrayImageView(floatView);
+            break;
+        }
+        case Stage::rgb: {
+            rgbImg->GetRgbImageView(planes);
+            break;
+        }
+        case Stage::processedRgb: {
+            processedRgbImg->GetRgbImageView(planes);
+            break;
+        }
+    }
+    // At most one of the views is set.
+    data = nullptr;
+    size_t bytes{ 0 };
+    auto addView{ [&data, &bytes](const auto& view, size_t planeCount) {
+        if (view.Empty())
+            return;
+        data = view.Data();
+        bytes = planeCount * static_cast<size_t>(view.Height()) * view.Stride() * sizeof(*view.Data());
+    } };
+    addView(realView, 1);
+    addView(floatView, 1);
+    addView(complexView, 1);
+    addView(complexFloatView, 1);
+    addView(planes[0], 3);
+    return bytes;
+}
+
+void ImageFilter::resetStage(Stage stage) {
+    clearStage(stage);
+    stageChanged(stage);
+}
 
-    for (int i = 0; i < idftMat.size(); i++) {
-        for (int j = 0; j < idftMat[0].size(); j++) {
-            idftMat[i][j] /= static_cast<int>(idftMat.size()) * static_cast<int>(idftMat[0].size());
+void ImageFilter::stageChanged(Stage stage) {
+    droppedStages[stageIndex(stage)] = false;
+    stageVersions[stageIndex(stage)]++;
+    for (auto& cached : bitmapCache[stageIndex(stage)])
+        cached = CachedBitmap{};
+}
+
+void ImageFilter::clearStage(Stage stage) {
+    switch (stage) {
+        case Stage::original: {
+            originalImg->Reset();
+            break;
+        }
+        case Stage::resized: {
+            resizedImg->Reset();
+            break;
+        }
+        case Stage::noisy: {
+            noisyImg->Reset();
+            break;
+        }
+        case Stage::dft: {
+            imgDFT->Reset();
+            break;
+        }
+        case Stage::maskedDft: {
+            imgDFTMasked->Reset();
+            break;
+        }
+        case Stage::processed: {
+            processedImg->Reset();
+            break;
+        }
+        case Stage::rgb: {
+            rgbImg->Reset();
+            break;
+        }
+        case Stage::processedRgb: {
+            processedRgbImg->Reset();
+            break;
         }
     }
-    
-    mat idftMatReal(dftMat.size(), std::vector<double>(dftMat[0].size(), 0));
-    for (int i = 0; i < idftMat.size(); i++) {
-        for (int j = 0; j < idftMat[0].size(); j++) {
-            idftMatReal[i][j] = std::max(0.0, idftMat[i][j].real());
+}
+
+void ImageFilter::restoreStage(Stage stage) {
+    // Inputs are restored first; each stage is recomputed with the parameters it was made with.
+    if (!droppedStages[stageIndex(stage)])
+        return;
+    droppedStages[stageIndex(stage)] = false;
+    switch (stage) {
+        case Stage::noisy: {
+            noisyImg->SetGrayImageMat(computeNoisy());
+            break;
+        }
+        case Stage::dft: {
+            restoreStage(Stage::noisy);
+            computeDFT(dftPrecision);
+            break;
         }
+        case Stage::maskedDft: {
+            restoreStage(Stage::dft);
+            computeMasked(*imgDFTMasked, appliedMaskSize, appliedMaskPass);
+            break;
+        }
+        case Stage::processed: {
+            // The processed image may predate the current mask, then its own mask is recomputed.
+            if (processedMaskSize == appliedMaskSize && processedMaskPass == appliedMaskPass) {
+                restoreStage(Stage::maskedDft);
+                computeProcessed(*imgDFTMasked, processedPrecision);
+            }
+            else {
+                restoreStage(Stage::dft);
+                Image::HalfSpectrumImageWx processedMaskedImg(bufferPool);
+                computeMasked(processedMaskedImg, processedMaskSize, processedMaskPass);
+                computeProcessed(processedMaskedImg, processedPrecision);
+            }
+            break;
+        }
+        case Stage::processedRgb: {
+            processedRgbImg->SetRgbImageMat(computeProcessedRgb(rgbPrecision, rgbMaskSize, rgbMaskPass));
+            break;
+        }
+        default:
+            break;
     }
-    processedImg->SetGrayImageMat(idftMatReal);
 }
 
+void ImageFilter::releaseCaches() {
+    for (auto& stageCache : bitmapCache) {
+        for (auto& cached : stageCache)
+            cached = CachedBitmap{};
+    }
+    imgDFT->ReleaseCache();
+    imgDFTMasked->ReleaseCache();
+}
 
-template <typename T> T ImageFilter::fftShift(const T& matrix) {
+void ImageFilter::enforceStageMemoryBudget() {
+    if (stageMemoryBudget == 0)
+        return;
+    // The caches are rebuilt from the stages alone, cheaper than any stage.
+    if (GetStageMemoryReport().residentBytes > stageMemoryBudget)
+        releaseCaches();
+    // Cheapest to recompute first. The loaded and resized images are never dropped.
+    for (Stage stage : { Stage::maskedDft, Stage::noisy, Stage::processed, Stage::processedRgb, Stage::dft }) {
+        StageMemoryReport report{ GetStageMemoryReport() };
+        if (report.residentBytes <= stageMemoryBudget)
+            break;
+        // Without noise the noisy image shares the resized one, dropping it frees nothing.
+        if (report.stageBytes[stageIndex(stage)] == 0 || (stage == Stage::noisy && !noiseApplied))
+            continue;
+        // Same data once recomputed, so the version stays.
+        clearStage(stage);
+        droppedStages[stageIndex(stage)] = true;
+    }
+    // Pooled buffers are kept for the next stages to reuse, unless the stages alone still exceed the budget.
+    if (GetStageMemoryReport().residentBytes > stageMemoryBudget)
+        bufferPool.Trim();
+}
 
-    T shiftedMatrix;
-    shiftedMatrix.resize(matrix.size());
-    for (auto& row : shiftedMatrix) row.resize(matrix[0].size());
+ImageFilter::PrecisionReport ImageFilter::ComparePrecision() {
+    using namespace Image;
+    PrecisionReport report{};
+    restoreStage(Stage::noisy);
+    restoreStage(Stage::maskedDft);
+    MatrixView<const double> noisyMat{};
+    noisyImg->GetGrayImageView(noisyMat);
+    if (noisyMat.Empty())
+        return report;
+
+    int width{ noisyMat.Width() };
+    matComplex spectrum64{ forwardTransform<double>(noisyMat) };
+    matComplexFloat spectrum32{ forwardTransform<float>(noisyMat) };
+    double errorEnergy{ 0 };
+    double signalEnergy{ 0 };
+    for (int i = 0; i < spectrum64.Height(); i++) {
+        for (int j = 0; j < spectrum64.Width(); j++) {
+            // Columns other than 0 and width / 2 also stand for their mirrors in the full spectrum.
+            double weight{ j == 0 || 2 * j == width ? 1.0 : 2.0 };
+            errorEnergy += weight * std::norm(static_cast<std::complex<double>>(spectrum32[i][j]) - spectrum64[i][j]);
+            signalEnergy += weight * std::norm(spectrum64[i][j]);
+        }
+    }
+    report.spectrumRelativeRms = signalEnergy > 0 ? std::sqrt(errorEnergy / signalEnergy) : 0;
+
+    // Filter with the current mask when there is one, in the precision it is stored in, otherwise
+    // transform the spectrum back unchanged.
+    auto compareImages{ [this, &report, width](auto maskedMat) {
+        mat image64{ inverseTransform<double>(maskedMat, width) };
+        matFloat image32{ inverseTransform<float>(maskedMat, width) };
+        double squaredError{ 0 };
+        for (int i = 0; i < image64.Height(); i++) {
+            for (int j = 0; j < image64.Width(); j++) {
+                double error{ std::abs(image32[i][j] - image64[i][j]) };
+                report.imageMaxError = std::max(report.imageMaxError, error);
+                squaredError += error * error;
+            }
+        }
+        report.imageRmsError = std::sqrt(squaredError / (static_cast<double>(image64.Height()) * image64.Width()));
+    } };
+    MatrixView<const std::complex<double>> maskedMat{};
+    MatrixView<const std::complex<float>> maskedMatFloat{};
+    int maskedWidth{};
+    imgDFTMasked->GetHalfSpectrumView(maskedMat, maskedWidth);
+    imgDFTMasked->GetHalfSpectrumView(maskedMatFloat, maskedWidth);
+    if (maskedWidth != width || std::max(maskedMat.Height(), maskedMatFloat.Height()) != spectrum64.Height())
+        compareImages(MatrixView<const std::complex<double>>{ spectrum64.View() });
+    else if (!maskedMatFloat.Empty())
+        compareImages(maskedMatFloat);
+    else
+        compareImages(maskedMat);
+    return report;
+}
 
-    int yhalf = matrix.size() / 2;
-    int xhalf = matrix[0].size() / 2;
-    int yodd = matrix.size() % 2;
-    int xodd = matrix[0].size() % 2;
+template <typename T> Image::Matrix<std::complex<T>> ImageFilter::forwardTransform(Image::MatrixView<const double> realMat) {
+    int height{ realMat.Height() };
+    int width{ realMat.Width() };
+    // The forward transform does not modify its input, a double image is read in place and needs no
+    // workspace. A float one converts it into a copy, which the out of core transform streams instead.
+    constexpr bool readsInPlace{ std::is_same_v<T, double> };
+    if constexpr (!readsInPlace) {
+        if (exceedsMemoryBudget(static_cast<size_t>(height) * width * sizeof(T))) {
+            Image::Matrix<std::complex<T>> halfMat{};
+            if (forwardTransformOutOfCore<T>(realMat, halfMat))
+                return halfMat;
+        }
+    }
 
-    for (int i = 0; i < xhalf + xodd; i++) 
-        for (int j = 0; j < yhalf + yodd; j++) 
-            shiftedMatrix[j][i] = matrix[j + yhalf][i + xhalf];
-   
-    for (int i = 0; i < xhalf; i++) 
-        for (int j = 0; j < yhalf; j++) 
-            shiftedMatrix[j + yhalf + yodd][i + xhalf + xodd] = matrix[j][i];
-       
-    for (int i = 0; i < xhalf; i++) 
-        for (int j = 0; j < yhalf + yodd; j++) 
-            shiftedMatrix[j][i + xhalf + xodd] = matrix[j + yhalf][i];
-  
-    for (int i = 0; i < xhalf + xodd; i++) 
-        for (int j = 0; j < yhalf; j++) 
-            shiftedMatrix[j + yhalf + yodd][i] = matrix[j][i + xhalf];
-     
-    //shiftedMatrix[yhalf + yodd][xhalf + xodd] = 0;
-    return shiftedMatrix;
+    // Real input: the half spectrum holds all of it.
+    Image::Matrix<std::complex<T>> halfMat(bufferPool, height, width / 2 + 1);
+    if constexpr (readsInPlace) {
+        FFT::rfft2D(realMat.Data(), height, width, realMat.Stride(), halfMat.Data(), halfMat.Stride(), 1);
+    }
+    else {
+        Image::Matrix<T> inputMat(bufferPool, height, width);
+        for (int i = 0; i < height; i++)
+            std::copy(realMat[i], realMat[i] + width, inputMat[i]);
+        FFT::rfft2D(inputMat.Data(), height, width, inputMat.Stride(), halfMat.Data(), halfMat.Stride(), 1);
+    }
+    return halfMat;
 }
 
-template <typename T> T ImageFilter::ifftShift(const T& matrix) {
-
-    T shiftedMatrix;
-    shiftedMatrix.resize(matrix.size());
-    for (auto& row : shiftedMatrix) row.resize(matrix[0].size());
+template <typename T, typename S> Image::Matrix<T> ImageFilter::inverseTransform(Image::MatrixView<const std::complex<S>> halfMat, int width) {
+    int height{ halfMat.Height() };
+    // The workspace is the copy of the half spectrum below.
+    if (exceedsMemoryBudget(static_cast<size_t>(height) * halfMat.Width() * sizeof(std::complex<T>))) {
+        Image::Matrix<T> idftMat{};
+        if (inverseTransformOutOfCore<T>(halfMat, width, idftMat))
+            return idftMat;
+    }
+    // The inverse uses its input as workspace, so it gets a copy of the stage, in precision T.
+    Image::Matrix<std::complex<T>> workMat(bufferPool, height, halfMat.Width());
+    for (int i = 0; i < height; i++)
+        std::copy(halfMat[i], halfMat[i] + halfMat.Width(), workMat[i]);
+    Image::Matrix<T> idftMat(bufferPool, height, width);
+    FFT::irfft2D(workMat.Data(), workMat.Stride(), height, width, idftMat.Data(), idftMat.Stride(), -1);
+
+    double normConst{ static_cast<double>(height) * width };
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            idftMat[i][j] = static_cast<T>(std::max(0.0, static_cast<double>(idftMat[i][j]) / normConst));
+        }
+    }
+    return idftMat;
+}
 
-    int yhalf = matrix.size() / 2;
-    int xhalf = matrix[0].size() / 2;
-    int yodd = matrix.size() % 2;
-    int xodd = matrix[0].size() % 2;
+template <typename T> bool ImageFilter::forwardTransformOutOfCore(Image::MatrixView<const double> realMat, Image::Matrix<std::complex<T>>& halfMat) {
+    // Same as forwardTransform, with the image streamed in and the half spectrum streamed straight into halfMat.
+    // halfMat is the result, in memory as in core; only the scratch buffers are held to the budget.
+    int height{ realMat.Height() };
+    int width{ realMat.Width() };
+    int halfWidth{ width / 2 + 1 };
+    halfMat = Image::Matrix<std::complex<T>>(bufferPool, height, halfWidth);
+    auto readRow{ [&realMat, width](int i, T* row) {
+        std::copy(realMat[i], realMat[i] + width, row);
+    } };
+    auto writeRow{ [&halfMat, halfWidth](int i, const std::complex<T>* row) {
+        std::copy(row, row + halfWidth, halfMat[i]);
+    } };
+    return FFT::rfft2DOutOfCore<T>(height, width, readRow, writeRow, 1, { memoryBudget, scratchDirectory });
+}
 
-    for (int i = 0; i < xhalf; i++)
-        for (int j = 0; j < yhalf; j++)
-            shiftedMatrix[j][i] = matrix[j + yhalf + yodd][i + xhalf + xodd];
+template <typename T, typename S> bool ImageFilter::inverseTransformOutOfCore(Image::MatrixView<const std::complex<S>> halfMat, int width, Image::Matrix<T>& idftMat) {
+    // Same as inverseTransform, with the half spectrum streamed in and the normalized image streamed out.
+    int height{ halfMat.Height() };
+    double normConst{ static_cast<double>(height) * width };
+    idftMat = Image::Matrix<T>(bufferPool, height, width, 0);
+    auto readRow{ [&halfMat](int i, std::complex<T>* row) {
+        std::copy(halfMat[i], halfMat[i] + halfMat.Width(), row);
+    } };
+    auto writeRow{ [&idftMat, width, normConst](int i, const T* row) {
+        for (int j = 0; j < width; j++)
+            idftMat[i][j] = static_cast<T>(std::max(0.0, static_cast<double>(row[j]) / normConst));
+    } };
+    return FFT::irfft2DOutOfCore<T>(height, width, readRow, writeRow, -1, { memoryBudget, scratchDirectory });
+}
 
-    for (int i = 0; i < xhalf + xodd; i++)
-        for (int j = 0; j < yhalf + yodd; j++)
-            shiftedMatrix[j + yhalf][i + xhalf] = matrix[j][i];
+template <typename T> Image::Matrix<std::complex<T>> ImageFilter::applyMask(Image::MatrixView<const std::complex<T>> dftMat, const Image::mat& mask) {
+    Image::Matrix<std::complex<T>> maskedMat(bufferPool, dftMat.Height(), dftMat.Width(), { 0, 0 });
+    for (int i = 0; i < dftMat.Height(); i++) 
+        for (int j = 0; j < dftMat.Width(); j++) 
+            maskedMat[i][j] = dftMat[i][j] * static_cast<T>(mask[i][j]);
+    return maskedMat;
+}
 
-    for (int i = 0; i < xhalf + xodd; i++)
-        for (int j = 0; j < yhalf; j++)
-            shiftedMatrix[j][i + xhalf] = matrix[j + yhalf + yodd][i];
+bool ImageFilter::exceedsMemoryBudget(size_t workspaceBytes) const {
+    // The results are stages, held either way, so only the workspace is weighed against the budget.
+    return memoryBudget > 0 && workspaceBytes > memoryBudget;
+}
 
-    for (int i = 0; i < xhalf; i++)
-        for (int j = 0; j < yhalf + yodd; j++)
-            shiftedMatrix[j + yhalf][i] = matrix[j][i + xhalf + xodd];
+template <typename T> Image::matRgb ImageFilter::filterRgb(Image::rgbView planes, double maskSize, FilterPassMode pass) {
+    using namespace Image;
+    int height{ planes[0].Height() };
+    int width{ planes[0].Width() };
+    double normConst{ static_cast<double>(height) * width };
+    mat mask{ naturalOrderMask(width, height, maskSize, pass) };
+    matRgb filteredMat{ mat(bufferPool, height, width), mat(bufferPool, height, width), mat(bufferPool, height, width) };
+
+    // Red and green as the real and imaginary parts of one complex image. The mask is real and
+    // symmetric, so each part is filtered on its own and comes back in place.
+    auto filterPair{ [&]() {
+        Matrix<std::complex<T>> packedMat(bufferPool, height, width);
+        for (int i = 0; i < height; i++) {
+            for (int j = 0; j < width; j++) {
+                packedMat[i][j] = { static_cast<T>(planes[0][i][j]), static_cast<T>(planes[1][i][j]) };
+            }
+        }
+        FFT::fft2D(packedMat.Data(), height, width, packedMat.Stride(), 1);
+        for (int i = 0; i < height; i++) {
+            for (int j = 0; j < width; j++) {
+                packedMat[i][j] *= static_cast<T>(mask[i][j]);
+            }
+        }
+        FFT::fft2D(packedMat.Data(), height, width, packedMat.Stride(), -1);
+        for (int i = 0; i < height; i++) {
+            for (int j = 0; j < width; j++) {
+                filteredMat[0][i][j] = std::max(0.0, static_cast<double>(packedMat[i][j].real()) / normConst);
+                filteredMat[1][i][j] = std::max(0.0, static_cast<double>(packedMat[i][j].imag()) / normConst);
+            }
+        }
+    } };
+
+    // Blue through the real transform, masked in its half spectrum.
+    auto filterSingle{ [&]() {
+        Matrix<T> blueMat(bufferPool, height, width);
+        for (int i = 0; i < height; i++) {
+            for (int j = 0; j < width; j++) {
+                blueMat[i][j] = static_cast<T>(planes[2][i][j]);
+            }
+        }
+        Matrix<std::complex<T>> halfMat(bufferPool, height, width / 2 + 1);
+        FFT::rfft2D(blueMat.Data(), height, width, blueMat.Stride(), halfMat.Data(), halfMat.Stride(), 1);
+        for (int i = 0; i < height; i++) {
+            for (int j = 0; j < halfMat.Width(); j++) {
+                halfMat[i][j] *= static_cast<T>(mask[i][j]);
+            }
+        }
+        FFT::irfft2D(halfMat.Data(), halfMat.Stride(), height, width, blueMat.Data(), blueMat.Stride(), -1);
+        for (int i = 0; i < height; i++) {
+            for (int j = 0; j < width; j++) {
+                filteredMat[2][i][j] = std::max(0.0, static_cast<double>(blueMat[i][j]) / normConst);
+            }
+        }
+    } };
 
-    //shiftedMatrix[yhalf + yodd][xhalf + xodd] = 0;
-    return shiftedMatrix;
+    // One after the other: each transform already runs its passes on every worker thread, while
+    // as two chunks of one ParallelFor their passes would run inline, on two threads in all.
+    filterPair();
+    filterSingle();
+    return filteredMat;
 }
 
 
-wxBitmap ImageFilter::NoisyImageBmp() {
-    wxBitmap bmp(1,1);
-    noisyImg->GetWxBitmap(bmp);
+wxBitmap ImageFilter::StageBitmap(Stage stage, BitmapScale scale) {
+    CachedBitmap& cached{ bitmapCache[stageIndex(stage)][static_cast<size_t>(scale)] };
+    if (cached.valid && cached.version == stageVersions[stageIndex(stage)])
+        return cached.bitmap;
+    restoreStage(stage);
+    wxBitmap bmp(1, 1);
+    switch (stage) {
+        case Stage::original: {
+            originalImg->GetWxBitmap(bmp);
+            break;
+        }
+        case Stage::resized: {
+            resizedImg->GetWxBitmap(bmp);
+            break;
+        }
+        case Stage::noisy: {
+            noisyImg->GetWxBitmap(bmp);
+            break;
+        }
+        case Stage::dft: {
+            if (scale == BitmapScale::log2)
+                imgDFT->GetLogWxBitmap(bmp);
+            else
+                imgDFT->GetWxBitmap(bmp);
+            break;
+        }
+        case Stage::maskedDft: {
+            if (scale == BitmapScale::log2)
+                imgDFTMasked->GetLogWxBitmap(bmp);
+            else
+                imgDFTMasked->GetWxBitmap(bmp);
+            break;
+        }
+        case Stage::processed: {
+            processedImg->GetWxBitmap(bmp);
+            break;
+        }
+        case Stage::rgb: {
+            rgbImg->GetWxBitmap(bmp);
+            break;
+        }
+        case Stage::processedRgb: {
+            processedRgbImg->GetWxBitmap(bmp);
+            break;
+        }
+    }
+    cached = { true, stageVersions[stageIndex(stage)], bmp };
     return bmp;
 }
 
+wxBitmap ImageFilter::NoisyImageBmp() {
+    return StageBitmap(Stage::noisy);
+}
+
 wxBitmap ImageFilter::DFTImageBmp() {
-    wxBitmap bmp(1, 1);
-    imgDFT->GetWxBitmap(bmp);
-    return bmp;
+    return StageBitmap(Stage::dft);
 }
 
 wxBitmap ImageFilter::LogDFTImageBmp() {
-    using namespace Image;
-    matComplex compMat{};
-    imgDFT->GetGrayImageComplexMat(compMat);
-    wxBitmap bmp(1, 1);
-    if (compMat.empty() || compMat[0].empty())
-        return bmp;
-    mat logMat{ logify(compMat) };
-    return toWxBitmap(logMat);
+    return StageBitmap(Stage::dft, BitmapScale::log2);
 }
 
 wxBitmap ImageFilter::MaskedDFTImageBmp() {
-    wxBitmap bmp(1, 1);
-    imgDFTMasked->GetWxBitmap(bmp);
-    return bmp;
+    return StageBitmap(Stage::maskedDft);
 }
 
 wxBitmap ImageFilter::LogMaskedDFTImageBmp() {
-    using namespace Image;
-    matComplex compMat{};
-    imgDFTMasked->GetGrayImageComplexMat(compMat);
-    wxBitmap bmp(1, 1);
-    if (compMat.empty() || compMat[0].empty())
-        return bmp;
-    mat logMat{ logify(compMat) };
-    return toWxBitmap(logMat);
+    return StageBitmap(Stage::maskedDft, BitmapScale::log2);
 }
 
 wxBitmap ImageFilter::ProccessedImageBmp() {
-    wxBitmap bmp(1, 1);
-    processedImg->GetWxBitmap(bmp);
-    return bmp;
+    return StageBitmap(Stage::processed);
 }
 
-Image::mat ImageFilter::logify(const Image::matComplex& mat) {
-    Image::mat logMat{};
-    logMat = Image::mat(mat.size(), std::vector<double>(mat[0].size(), 0));
-    for (int i = 0; i < mat.size(); i++) {
-        for (int j = 0; j < mat[0].size(); j++) {
-            double val{ 1.0 + std::sqrt(mat[i][j].real() * mat[i][j].real() + mat[i][j].imag() * mat[i][j].imag()) };
-            logMat[i][j] = std::log2(val);
-        }
-    }
-    return logMat;
+wxBitmap ImageFilter::RgbImageBmp() {
+    return StageBitmap(Stage::rgb);
 }
 
-wxBitmap ImageFilter::toWxBitmap(const Image::mat& mat) {
-    // Temporary image for bitmap conversion.
-    std::unique_ptr<Image::IRealGrayImageWx> tempImage{ std::make_unique<Image::RealGrayImageWx>() };
-    wxBitmap bmp(1, 1);
-    tempImage->SetGrayImageMat(mat);
-    tempImage->GetWxBitmap(bmp);
-    return bmp;
+wxBitmap ImageFilter::ProcessedRgbImageBmp() {
+    return StageBitmap(Stage::processedRgb);
 }
 
 Image::mat ImageFilter::generateMask(int width, int height, int maskSize, FilterPassMode pass) {
-    Image::mat mask(height, std::vector<double>(width, 0.0));
+    Image::mat mask(bufferPool, height, width, 0.0);
     //double centerX{ static_cast<double>(width) / 2 };
     //double centerY{ static_cast<double>(height) / 2 };
     int centerX{ width / 2 };
@@ -379,4 +865,24 @@ Image::mat ImageFilter::generateMask(int width, int height, int maskSize, Filter
         }
     }
     return mask;
+}
+
+int ImageFilter::maskRadius(int width, int height, double maskSize) {
+    return static_cast<int>(std::sqrt(static_cast<double>(height) * static_cast<double>(height) +
+                                      static_cast<double>(width) * static_cast<double>(width)) * maskSize / 2.0);
+}
+
+Image::mat ImageFilter::naturalOrderMask(int width, int height, double maskSize, FilterPassMode pass) {
+    Image::mat centeredMask{ generateMask(width, height, maskRadius(width, height, maskSize), pass) };
+    Image::mat mask(bufferPool, height, width, 0.0);
+    // Index of transform order index 'k' in the centered spectrum, as placed by forwardTransform.
+    auto centered{ [](int k, int size) { return (k + size - size / 2) % size; } };
+    for (int i = 0; i < height; i++) {
+        const double* row{ centeredMask[centered(i, height)] };
+        const double* mirrorRow{ centeredMask[centered((height - i) % height, height)] };
+        for (int j = 0; j < width; j++) {
+            mask[i][j] = 0.5 * (row[centered(j, width)] + mirrorRow[centered((width - j) % width, width)]);
+        }
+    }
+    return mask;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include "ImageWx.hpp"
+#include <array>
+#include <cstdint>
 #include <memory>
 
 class ImageFilter {
@@ -14,7 +16,49 @@ public:
         bilinear,
     };
 
-    
+    enum class TransformPrecision {
+        float32,
+        float64,
+    };
+
+    enum class Stage {
+        original,
+        resized,
+        noisy,
+        dft,
+        maskedDft,
+        processed,
+        rgb,
+        processedRgb,
+    };
+    static constexpr size_t stageCount{ 8 };
+
+    enum class BitmapScale {
+        linear,
+        log2,       // log2(1 + magnitude) for the spectra, the same as linear for the images.
+    };
+
+    /**
+    * Memory held by the stored images, indexed by Stage. Dropped stages hold none until used again.
+    */
+    struct StageMemoryReport {
+        std::array<size_t, stageCount> stageBytes{};    // Bytes of each stage's matrix.
+        std::array<bool, stageCount> droppedStages{};   // Stages dropped to stay within the budget.
+        size_t cacheBytes{};                            // Cached stage bitmaps and log-magnitude maps of the spectra.
+        size_t residentBytes{};                         // Total of the stages, shared buffers counted once, and caches.
+        size_t pooledBytes{};                           // Freed buffers kept by the buffer pool for reuse.
+        size_t budget{};                                // Stage memory budget, 0 for none.
+    };
+
+    /**
+    * Deviation of the float32 transforms from the float64 ones for the current image.
+    */
+    struct PrecisionReport {
+        double spectrumRelativeRms{};   // RMS error of the spectrum relative to its RMS value.
+        double imageMaxError{};         // Largest error of a processed image pixel, in gray levels.
+        double imageRmsError{};         // RMS error of the processed image, in gray levels.
+    };
+
 
     ImageFilter();
     ~ImageFilter() {};
@@ -28,28 +72,162 @@ public:
     */
     void ApplyFilterMask(double maskSize, FilterPassMode pass);
     void ComputeInverseFourierTransform();
+
+    /**
+    * Colour pipeline: load the image in three planes and filter them all with the mask of
+    * ApplyFilterMask, in the current transform precision. Two planes share one complex
+    * transform, the third goes through a real transform. A failed load keeps the current colour
+    * image and its filtered result. The raw gray frame formats have no colour and are rejected
+    * with invalidInput.
+    */
+    Image::ResultCode LoadRgbFromFile(std::string path);
+    void ApplyRgbFilterMask(double maskSize, FilterPassMode pass);
     void SaveAsFile(std::string path) {/*Not Implemented*/ };
+
+    /**
+    * Precision the Fourier transforms are computed in. The spectra and the processed image are
+    * stored in it, float32 halves their memory. The colour planes stay double either way.
+    */
+    void SetTransformPrecision(TransformPrecision newPrecision);
+    TransformPrecision GetTransformPrecision() const { return precision; }
+
+    /**
+    * Run both precisions on the current image (and mask, if applied) and compare the results.
+    */
+    PrecisionReport ComparePrecision();
+
+    /**
+    * Workspace the Fourier transforms may use on top of the stored images, 0 means no limit. It
+    * covers only the workspace: the result of a transform, the half spectrum or the processed
+    * image, is a stage held in memory either way and counted against the stage memory budget.
+    * In core, the workspace is a copy of the input in the transform precision; a double forward
+    * transform reads the image in place and needs none. Transforms whose workspace would exceed
+    * the budget run out of core instead, through a memory-mapped scratch file in
+    * 'scratchDirectory', with their buffers within the budget, reading the input and writing the
+    * result row by row.
+    * Off by default: the filter cannot tell how much memory the application can spare, so the
+    * embedding application has to set it. MainFrame does not, the app keeps every transform in core.
+    */
+    void SetMemoryBudget(size_t bytes, std::string scratchDirectory = "");
+    size_t GetMemoryBudget() const { return memoryBudget; }
+
+    /**
+    * Reuse of the pooled buffers of the images and temporaries, in bytes and counts.
+    */
+    Image::BufferPool::Stats GetBufferPoolStats() const { return bufferPool.GetStats(); }
+
+    /**
+    * Memory the stored images and their cached bitmaps may hold, 0 means no limit. Over it, the
+    * caches are dropped first, then the noisy image, spectra and processed image, cheapest to
+    * recompute first. They are rebuilt when next used.
+    * Checked after each operation that computes a stage, so stages restored to draw or compare
+    * them stay until then. Pooled buffers are freed only if the stages alone exceed it.
+    * Off by default, like the transform budget, and to be set by the embedding application;
+    * GetStageMemoryReport gives what the stages hold to size it. MainFrame keeps every stage.
+    */
+    void SetStageMemoryBudget(size_t bytes);
+    size_t GetStageMemoryBudget() const { return stageMemoryBudget; }
+    StageMemoryReport GetStageMemoryReport() const;
     
   
+    /**
+    * Bitmap of 'stage', built once per version and scale and cached until the stage changes.
+    */
+    wxBitmap StageBitmap(Stage stage, BitmapScale scale = BitmapScale::linear);
+
+    /**
+    * Count of changes to the data of 'stage'. Dropping and recomputing a stage keeps its version.
+    */
+    uint64_t GetStageVersion(Stage stage) const { return stageVersions[stageIndex(stage)]; }
+
     wxBitmap NoisyImageBmp();
     wxBitmap DFTImageBmp();
     wxBitmap LogDFTImageBmp();
     wxBitmap MaskedDFTImageBmp();
     wxBitmap LogMaskedDFTImageBmp();
     wxBitmap ProccessedImageBmp();
+    wxBitmap RgbImageBmp();
+    wxBitmap ProcessedRgbImageBmp();
     
 
 private:
+    // Declared first so it outlives the images holding its buffers.
+    Image::BufferPool bufferPool{};
     std::unique_ptr<Image::IRealGrayImageWx>    originalImg{};
     std::unique_ptr<Image::IRealGrayImageWx>    resizedImg{};
     std::unique_ptr<Image::IRealGrayImageWx>    noisyImg{};
-    std::unique_ptr<Image::IComplexGrayImageWx> imgDFT{};
-    std::unique_ptr<Image::IComplexGrayImageWx> imgDFTMasked{};
+    std::unique_ptr<Image::IHalfSpectrumImageWx> imgDFT{};
+    std::unique_ptr<Image::IHalfSpectrumImageWx> imgDFTMasked{};
     std::unique_ptr<Image::IRealGrayImageWx>    processedImg{};
+    std::unique_ptr<Image::IRealRgbImageWx>     rgbImg{};
+    std::unique_ptr<Image::IRealRgbImageWx>     processedRgbImg{};
+    TransformPrecision precision{ TransformPrecision::float64 };
+    size_t memoryBudget{ 0 };
+    std::string scratchDirectory{};
+    size_t stageMemoryBudget{ 0 };
+    std::array<bool, stageCount> droppedStages{};
+    std::array<uint64_t, stageCount> stageVersions{};
 
-    template <typename T> T fftShift(const T& matrix);
-    template <typename T> T ifftShift(const T& matrix);
-    Image::mat logify(const Image::matComplex& mat);
-    wxBitmap toWxBitmap(const Image::mat& mat);
+    struct CachedBitmap {
+        bool valid{ false };
+        uint64_t version{ 0 };
+        wxBitmap bitmap{};
+    };
+    std::array<std::array<CachedBitmap, 2>, stageCount> bitmapCache{};
+
+    // Parameters the derived stages were computed with, to recompute them once dropped.
+    bool noiseApplied{ false };
+    double noisePercent{ 0 };
+    unsigned int noiseSeed{ 0 };
+    TransformPrecision dftPrecision{ TransformPrecision::float64 };
+    double appliedMaskSize{ 0 };
+    FilterPassMode appliedMaskPass{ FilterPassMode::low };
+    TransformPrecision processedPrecision{ TransformPrecision::float64 };
+    double processedMaskSize{ 0 };
+    FilterPassMode processedMaskPass{ FilterPassMode::low };
+    TransformPrecision rgbPrecision{ TransformPrecision::float64 };
+    double rgbMaskSize{ 0 };
+    FilterPassMode rgbMaskPass{ FilterPassMode::low };
+
+    /**
+    * Stage results from their input stages and parameters. The spectra and the processed image
+    * are set straight into their image, in the precision they are computed in: the dft in
+    * 'transformPrecision', the masked dft in that of the dft.
+    */
+    Image::mat computeNoisy();
+    void computeDFT(TransformPrecision transformPrecision);
+    void computeMasked(Image::IHalfSpectrumImage& maskedImg, double maskSize, FilterPassMode pass);
+    void computeProcessed(const Image::IHalfSpectrumImage& maskedImg, TransformPrecision transformPrecision);
+    Image::matRgb computeProcessedRgb(TransformPrecision transformPrecision, double maskSize, FilterPassMode pass);
+
+    static size_t stageIndex(Stage stage) { return static_cast<size_t>(stage); }
+    size_t stageBytes(Stage stage, const void*& data) const;
+    void clearStage(Stage stage);
+    void resetStage(Stage stage);
+    void stageChanged(Stage stage);
+    void restoreStage(Stage stage);
+    void enforceStageMemoryBudget();
+    void releaseCaches();
+
+    /**
+    * Transforms between an image and the half of its spectrum, columns 0 to width / 2 in
+    * transform order. Only the bitmaps center the spectrum.
+    */
+    template <typename T> Image::Matrix<std::complex<T>> forwardTransform(Image::MatrixView<const double> realMat);
+    template <typename T, typename S> Image::Matrix<T> inverseTransform(Image::MatrixView<const std::complex<S>> halfMat, int width);
+    template <typename T> bool forwardTransformOutOfCore(Image::MatrixView<const double> realMat, Image::Matrix<std::complex<T>>& halfMat);
+    template <typename T, typename S> bool inverseTransformOutOfCore(Image::MatrixView<const std::complex<S>> halfMat, int width, Image::Matrix<T>& idftMat);
+    bool exceedsMemoryBudget(size_t workspaceBytes) const;
+    template <typename T> Image::Matrix<std::complex<T>> applyMask(Image::MatrixView<const std::complex<T>> dftMat, const Image::mat& mask);
+    template <typename T> Image::matRgb filterRgb(Image::rgbView planes, double maskSize, FilterPassMode pass);
     Image::mat generateMask(int width, int height, int maskSize, FilterPassMode pass);
+    int maskRadius(int width, int height, double maskSize);
+
+    /**
+    * The mask of the centered spectrum in transform order, made symmetric about frequency 0.
+    * Filtering a real image with it matches filtering the centered spectrum and keeping the
+    * real part, and leaves real and imaginary parts of a complex image apart. The half spectra
+    * use its columns 0 to width / 2.
+    */
+    Image::mat naturalOrderMask(int width, int height, double maskSize, FilterPassMode pass);
 };
\ No newline at end of file
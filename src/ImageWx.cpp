@@ -1,34 +1,192 @@
 #include "ImageWx.hpp"
+#include "Parallel.hpp"
 #include "wx/wx.h"
 #include <algorithm>
+#include <cmath>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace Image {
 
-    ResultCode RealGrayImageWx::LoadFromFile(std::string path) {
-       
-        wxImage image;
-        if (!image.LoadFile(std::string(path))) {
-            wxMessageBox("Failed to load image", "Error", wxOK | wxICON_ERROR);
-            return ResultCode::error;
+    namespace {
+        // Rows of at least this many pixels together are worth a thread.
+        constexpr int pixelGrain{ 1 << 16 };
+
+        int rowGrain(int width) {
+            return std::max(1, pixelGrain / std::max(width, 1));
         }
-        wxBitmap bitmap(image);
 
-        wxNativePixelData rawBmp(bitmap);
-        wxNativePixelData::Iterator p(rawBmp);
+        bool loadImage(const std::string& path, wxImage& image) {
+            if (!image.LoadFile(path)) {
+                wxMessageBox("Failed to load image", "Error", wxOK | wxICON_ERROR);
+                return false;
+            }
+            return true;
+        }
 
-        wxSize matSize = bitmap.GetSize();
-        m_mat = mat(matSize.y, std::vector<double>(matSize.x, 0));
+        /**
+        * Call rowRgb(int row, const unsigned char* rgb) with the packed RGB bytes of every row of
+        * 'image', rows in parallel. Rows are numbered bottom up, the same as the matrices.
+        */
+        template <typename Func>
+        void readRows(const wxImage& image, Func rowRgb) {
+            const int height{ image.GetHeight() };
+            const int width{ image.GetWidth() };
+            const unsigned char* data{ image.GetData() };
+            FFT::ParallelFor(height, rowGrain(width), [&](int begin, int end) {
+                for (int i = begin; i < end; i++)
+                    rowRgb(height - 1 - i, data + static_cast<ptrdiff_t>(i) * width * 3);
+            });
+        }
+
+        /**
+        * Luma of 'width' packed RGB pixels into 'luma'. T is double or complex, imaginary part zero.
+        */
+        template <typename T>
+        void rowLuma(const unsigned char* rgb, int width, T* luma) {
+            for (int j = 0; j < width; j++)
+                luma[j] = T(0.299 * rgb[3 * j] + 0.587 * rgb[3 * j + 1] + 0.114 * rgb[3 * j + 2]);
+        }
+
+        /**
+        * Fill the 24-bit 'bitmap' with colour levels, rows in parallel. 'rowLevels' is called as
+        * rowLevels(int row, unsigned char* red, unsigned char* green, unsigned char* blue) to set
+        * the width levels of each channel of a row.
+        */
+        template <typename Func>
+        void writeRgbPixels(wxBitmap& bitmap, int height, int width, Func rowLevels) {
+            using PixelFormat = wxNativePixelData::PixelFormat;
+            wxNativePixelData rawBmp(bitmap);
+            FFT::ParallelFor(height, rowGrain(width), [&rawBmp, width, &rowLevels](int begin, int end) {
+                std::vector<unsigned char> levels(3 * static_cast<size_t>(width));
+                unsigned char* red{ levels.data() };
+                unsigned char* green{ red + width };
+                unsigned char* blue{ green + width };
+                wxNativePixelData::Iterator p(rawBmp);
+                p.OffsetY(rawBmp, begin);
+                for (int i = begin; i < end; i++) {
+                    wxNativePixelData::Iterator rowStart = p;
+                    rowLevels(i, red, green, blue);
+                    unsigned char* pixel{ p.m_ptr };
+                    for (int j = 0; j < width; j++, pixel += PixelFormat::SizePixel) {
+                        pixel[PixelFormat::RED] = red[j];
+                        pixel[PixelFormat::GREEN] = green[j];
+                        pixel[PixelFormat::BLUE] = blue[j];
+                    }
+                    p = rowStart;
+                    p.OffsetY(rawBmp, 1);
+                }
+            });
+        }
 
-        for (int i = 0; i < m_mat.size(); i++) {
-            wxNativePixelData::Iterator rowStart = p;
-            for (int j = 0; j < m_mat[0].size(); j++, p++) {
-                // y coordinate index (i) has an offset since a bitmap pointer (p) starts from the top left pixel.
-                m_mat[m_mat.size() - 1 - i][j] = 0.299 * p.Red() + 0.587 * p.Green() + 0.114 * p.Blue();
+        /**
+        * writeRgbPixels with gray levels. 'rowLevels' is called as rowLevels(int row, unsigned char* levels).
+        */
+        template <typename Func>
+        void writePixels(wxBitmap& bitmap, int height, int width, Func rowLevels) {
+            writeRgbPixels(bitmap, height, width, [width, &rowLevels](int i, unsigned char* red, unsigned char* green, unsigned char* blue) {
+                rowLevels(i, red);
+                std::copy(red, red + width, green);
+                std::copy(red, red + width, blue);
+            });
+        }
+
+        /**
+        * writePixels for the full spectrum of a real image of 'width' columns, with frequency 0 at
+        * the center, from 'halfMat', its columns 0 to width / 2 in transform order. 'level' is
+        * called as level(const T& value) with the half's element for each pixel. Columns past the
+        * half are read from their mirrors X[-i][-j], which only differ by conjugation.
+        */
+        template <typename T, typename Func>
+        void writeCenteredSpectrum(wxBitmap& bitmap, const Matrix<T>& halfMat, int width, Func level) {
+            const int height{ halfMat.Height() };
+            const int halfWidth{ halfMat.Width() };
+            writePixels(bitmap, height, width, [&](int i, unsigned char* levels) {
+                int k{ (i + height / 2) % height };
+                const T* row{ halfMat[k] };
+                const T* mirrorRow{ halfMat[(height - k) % height] };
+                for (int j = 0; j < width; j++) {
+                    int l{ (j + width / 2) % width };
+                    levels[j] = level(l < halfWidth ? row[l] : mirrorRow[width - l]);
+                }
+            });
+        }
+
+        /**
+        * Smallest and largest of 'values(j)' for j in [0, width), in independent lanes the compiler can vectorize.
+        */
+        template <typename Func>
+        std::pair<double, double> rowMinMax(int width, Func values) {
+            constexpr int lanes{ 8 };
+            double minLanes[lanes];
+            double maxLanes[lanes];
+            std::fill_n(minLanes, lanes, values(0));
+            std::fill_n(maxLanes, lanes, values(0));
+            int j{ 0 };
+            for (; j + lanes <= width; j += lanes) {
+                for (int k = 0; k < lanes; k++) {
+                    double value{ values(j + k) };
+                    minLanes[k] = value < minLanes[k] ? value : minLanes[k];
+                    maxLanes[k] = value > maxLanes[k] ? value : maxLanes[k];
+                }
+            }
+            for (; j < width; j++) {
+                minLanes[0] = std::min(minLanes[0], values(j));
+                maxLanes[0] = std::max(maxLanes[0], values(j));
             }
-            p = rowStart;
-            p.OffsetY(rawBmp, 1);
+            return { *std::min_element(minLanes, minLanes + lanes), *std::max_element(maxLanes, maxLanes + lanes) };
+        }
+
+        /**
+        * rowMinMax over all rows, rows in parallel.
+        */
+        template <typename Func>
+        std::pair<double, double> matrixMinMax(int height, int width, Func rowValues) {
+            std::vector<std::pair<double, double>> rowsMinMax(height);
+            FFT::ParallelFor(height, rowGrain(width), [&](int begin, int end) {
+                for (int i = begin; i < end; i++)
+                    rowsMinMax[i] = rowValues(i);
+            });
+            std::pair<double, double> minMax{ rowsMinMax[0] };
+            for (const auto& [rowMin, rowMax] : rowsMinMax) {
+                minMax.first = std::min(minMax.first, rowMin);
+                minMax.second = std::max(minMax.second, rowMax);
+            }
+            return minMax;
+        }
+
+        /**
+        * 24-bit bitmap of 'imgMat' in gray levels from its range, a flat image is black.
+        */
+        template <typename T>
+        wxBitmap grayBitmap(const Matrix<T>& imgMat) {
+            auto [minVal, maxVal] { matrixMinMax(imgMat.Height(), imgMat.Width(), [&imgMat](int i) {
+                const T* row{ imgMat[i] };
+                return rowMinMax(imgMat.Width(), [row](int j) { return static_cast<double>(row[j]); });
+            }) };
+            double range{ maxVal - minVal };
+            wxBitmap matBitmap(imgMat.Width(), imgMat.Height(), 24);
+            writePixels(matBitmap, imgMat.Height(), imgMat.Width(), [&imgMat, minVal, range](int i, unsigned char* levels) {
+                const T* row{ imgMat[i] };
+                for (int j = 0; j < imgMat.Width(); j++)
+                    levels[j] = range > 0 ? static_cast<unsigned char>((row[j] - minVal) / range * 255) : 0;
+            });
+            return matBitmap;
         }
+    }
+
+    ResultCode RealGrayImageWx::LoadFromFile(std::string path) {
+        wxImage image;
+        if (!loadImage(path, image))
+            return ResultCode::error;
+
+        mat loadedMat{ makeMat(image.GetHeight(), image.GetWidth()) };
+        readRows(image, [&loadedMat](int row, const unsigned char* rgb) {
+            rowLuma(rgb, loadedMat.Width(), loadedMat[row]);
+        });
+        m_mat = sharedMat(std::move(loadedMat));
+        m_floatMat = matFloat{};
         return ResultCode::ok;
     }
 
@@ -37,77 +195,75 @@ namespace Image {
     }
 
     ResultCode RealGrayImageWx::SetGrayImageMat(const mat& mat) {
-        m_mat = mat;
+        Image::mat copiedMat{ makeMat(mat.Height(), mat.Width()) };
+        copiedMat = mat;
+        m_mat = sharedMat(std::move(copiedMat));
+        m_floatMat = matFloat{};
         return ResultCode::ok;
     }
 
     ResultCode RealGrayImageWx::GetGrayImageMat(mat& mat) {
-        mat = m_mat;
+        mat = m_mat.Get();
+        return ResultCode::ok;
+    }
+
+    ResultCode RealGrayImageWx::GetGrayImageView(MatrixView<const double>& view) const {
+        view = m_mat.View();
+        return ResultCode::ok;
+    }
+
+    ResultCode RealGrayImageWx::SetGrayImageMat(mat&& mat) {
+        m_mat = sharedMat(std::move(mat));
+        m_floatMat = matFloat{};
+        return ResultCode::ok;
+    }
+
+    ResultCode RealGrayImageWx::TakeGrayImageMat(mat& mat) {
+        mat = m_mat.Release();
+        return ResultCode::ok;
+    }
+
+    ResultCode RealGrayImageWx::GetGrayImageShared(sharedMat& shared) const {
+        shared = m_mat;
+        return ResultCode::ok;
+    }
+
+    ResultCode RealGrayImageWx::SetGrayImageShared(const sharedMat& shared) {
+        m_mat = shared;
+        m_floatMat = matFloat{};
+        return ResultCode::ok;
+    }
+
+    ResultCode RealGrayImageWx::GetGrayImageView(MatrixView<const float>& view) const {
+        view = m_floatMat.View();
+        return ResultCode::ok;
+    }
+
+    ResultCode RealGrayImageWx::SetGrayImageMat(matFloat&& mat) {
+        m_floatMat = std::move(mat);
+        m_mat.Reset();
         return ResultCode::ok;
     }
 
     ResultCode RealGrayImageWx::GetWxBitmap(wxBitmap& bitmap) {
-        if (m_mat.size() == 0 || m_mat[0].size() == 0) {
+        if (m_mat.Empty() && m_floatMat.Empty()) {
             bitmap = wxBitmap(1, 1);
             return ResultCode::error;
         }
-            
-  
-        wxBitmap matBitmap(m_mat[0].size(), m_mat.size(), 24);
-        wxNativePixelData rawBmp(matBitmap);
-        wxNativePixelData::Iterator p(rawBmp);
-    
-        mat normalizedMat{ getNormalizedMat() };
-
-        for (int i = 0; i < normalizedMat.size(); i++) {
-            wxNativePixelData::Iterator rowStart = p;
-            for (int j = 0; j < normalizedMat[0].size(); j++, p++) {
-                
-                p.Red() = int(normalizedMat[i][j] * 255);
-                p.Green() = int(normalizedMat[i][j] * 255);
-                p.Blue() = int(normalizedMat[i][j] * 255);
-            }
-            p = rowStart;
-            p.OffsetY(rawBmp, 1);
-        }
-        bitmap = matBitmap;
+        bitmap = m_floatMat.Empty() ? grayBitmap(m_mat.Get()) : grayBitmap(m_floatMat);
         return ResultCode::ok;
     }
 
     ResultCode RealGrayImageWx::Reset() {
-        m_mat = mat{};
+        m_mat.Reset();
+        m_floatMat = matFloat{};
         return ResultCode::ok;
     }
     
-    mat RealGrayImageWx::getNormalizedMat() {
-        double maxVal = getMax();
-        double minVal = getMin();
-        double normConst = abs(maxVal - minVal);
-        mat normalizedMat{ m_mat };
-        if (normConst == 0) 
-            return normalizedMat;
-        for (auto& row : normalizedMat) {
-            for (auto& colElem : row) {
-                colElem = (colElem - minVal) / normConst;
-            }
-        }
-        return normalizedMat;
-    }
 
-    double RealGrayImageWx::getMax() {
-        std::vector<double> maxEachRow{};
-        for (auto& row : m_mat) {
-            maxEachRow.push_back(*std::max_element(row.begin(), row.end()));
-        }
-        return *std::max_element(maxEachRow.begin(), maxEachRow.end());
-    }   
 
-    double RealGrayImageWx::getMin() {
-        std::vector<double> minEachRow{};
-        for (auto& row : m_mat) {
-            minEachRow.push_back(*std::min_element(row.begin(), row.end()));
-        }
-        return *std::min_element(minEachRow.begin(), minEachRow.end());
+    mat RealGrayImageWx::makeMat(int height, int width) {
+        return m_pool != nullptr ? mat(*m_pool, height, width) : mat(height, width);
     }
 
  
@@ -115,27 +271,14 @@ namespace Image {
 
     ResultCode ComplexGrayImageWx::LoadFromFile(std::string path) {
         wxImage image;
-        if (!image.LoadFile(std::string(path))) {
-            wxMessageBox("Failed to load image", "Error", wxOK | wxICON_ERROR);
+        if (!loadImage(path, image))
             return ResultCode::error;
-        }
-        wxBitmap bitmap(image);
-
-        wxNativePixelData rawBmp(bitmap);
-        wxNativePixelData::Iterator p(rawBmp);
-
-        wxSize matSize = bitmap.GetSize();
-        m_mat = matComplex(matSize.y, std::vector<std::complex<double>>(matSize.x, {0.0, 0.0}));
 
-        for (int i = 0; i < m_mat.size(); i++) {
-            wxNativePixelData::Iterator rowStart = p;
-            for (int j = 0; j < m_mat[0].size(); j++, p++) {
-                // y coordinate index (i) has an offset since a bitmap pointer (p) starts from the top left pixel.
-                m_mat[m_mat.size() - 1 - i][j] = {0.299 * p.Red() + 0.587 * p.Green() + 0.114 * p.Blue(), 0.0};
-            }
-            p = rowStart;
-            p.OffsetY(rawBmp, 1);
-        }
+        matComplex loadedMat{ makeMat(image.GetHeight(), image.GetWidth()) };
+        readRows(image, [&loadedMat](int row, const unsigned char* rgb) {
+            rowLuma(rgb, loadedMat.Width(), loadedMat[row]);
+        });
+        m_mat = sharedMatComplex(std::move(loadedMat));
         return ResultCode::ok;
     }
 
@@ -144,83 +287,290 @@ namespace Image {
     }
 
     ResultCode ComplexGrayImageWx::SetGrayImageComplexMat(const matComplex& mat) {
-        m_mat = mat;
+        matComplex copiedMat{ makeMat(mat.Height(), mat.Width()) };
+        copiedMat = mat;
+        m_mat = sharedMatComplex(std::move(copiedMat));
         return ResultCode::ok;
     }
 
     ResultCode ComplexGrayImageWx::GetGrayImageComplexMat(matComplex& mat) {
-        mat = m_mat;
+        mat = m_mat.Get();
+        return ResultCode::ok;
+    }
+
+    ResultCode ComplexGrayImageWx::GetGrayImageComplexView(MatrixView<const std::complex<double>>& view) const {
+        view = m_mat.View();
+        return ResultCode::ok;
+    }
+
+    ResultCode ComplexGrayImageWx::SetGrayImageComplexMat(matComplex&& mat) {
+        m_mat = sharedMatComplex(std::move(mat));
+        return ResultCode::ok;
+    }
+
+    ResultCode ComplexGrayImageWx::TakeGrayImageComplexMat(matComplex& mat) {
+        mat = m_mat.Release();
+        return ResultCode::ok;
+    }
+
+    ResultCode ComplexGrayImageWx::GetGrayImageComplexShared(sharedMatComplex& shared) const {
+        shared = m_mat;
+        return ResultCode::ok;
+    }
+
+    ResultCode ComplexGrayImageWx::SetGrayImageComplexShared(const sharedMatComplex& shared) {
+        m_mat = shared;
         return ResultCode::ok;
     }
 
     ResultCode ComplexGrayImageWx::GetWxBitmap(wxBitmap& bitmap) {
-        if (m_mat.size() == 0 || m_mat[0].size() == 0) {
+        const matComplex& imgMat{ m_mat.Get() };
+        if (imgMat.Empty()) {
             bitmap = wxBitmap(1, 1);
             return ResultCode::error;
         }
 
-        wxBitmap matBitmap(m_mat[0].size(), m_mat.size(), 24);
-        wxNativePixelData rawBmp(matBitmap);
-        wxNativePixelData::Iterator p(rawBmp);
-    
-        matComplex normalizedMat{ getNormalizedMat() };
-
-        for (int i = 0; i < normalizedMat.size(); i++) {
-            wxNativePixelData::Iterator rowStart = p;
-            for (int j = 0; j < normalizedMat[0].size(); j++, p++) {
-                double matVal = normalizedMat[i][j].real()*normalizedMat[i][j].real() +
-                                normalizedMat[i][j].imag()*normalizedMat[i][j].imag();
-                p.Red() = int(matVal * 255);
-                p.Green() = int(matVal * 255);
-                p.Blue() = int(matVal * 255);
+        // Squared magnitudes over the squared range of the magnitudes, clipped to white.
+        auto [minNorm, maxNorm] { matrixMinMax(imgMat.Height(), imgMat.Width(), [&imgMat](int i) {
+            const std::complex<double>* row{ imgMat[i] };
+            return rowMinMax(imgMat.Width(), [row](int j) { return row[j].real() * row[j].real() + row[j].imag() * row[j].imag(); });
+        }) };
+        double range{ std::sqrt(maxNorm) - std::sqrt(minNorm) };
+        double scale{ range > 0 ? 255.0 / (range * range) : 0.0 };
+        wxBitmap matBitmap(imgMat.Width(), imgMat.Height(), 24);
+        writePixels(matBitmap, imgMat.Height(), imgMat.Width(), [&imgMat, scale](int i, unsigned char* levels) {
+            const std::complex<double>* row{ imgMat[i] };
+            for (int j = 0; j < imgMat.Width(); j++) {
+                double norm{ row[j].real() * row[j].real() + row[j].imag() * row[j].imag() };
+                levels[j] = static_cast<unsigned char>(std::min(norm * scale, 255.0));
             }
-            p = rowStart;
-            p.OffsetY(rawBmp, 1);
-        }
+        });
         bitmap = matBitmap;
         return ResultCode::ok;
     }
 
-    matComplex ComplexGrayImageWx::getNormalizedMat() {
-        double maxVal{ getMax() };
-        double minVal{ getMin() };
-        double normConst{ abs(maxVal - minVal) };
-        matComplex normalizedMat{ m_mat };
-        if (normConst == 0) 
-            return normalizedMat;
-        for (auto& row : normalizedMat) {
-            for (auto& colElem : row) {
-                colElem /= normConst;
-            }
+
+    ResultCode ComplexGrayImageWx::Reset() {
+        m_mat.Reset();
+        return ResultCode::ok;
+    }
+
+    matComplex ComplexGrayImageWx::makeMat(int height, int width) {
+        return m_pool != nullptr ? matComplex(*m_pool, height, width) : matComplex(height, width);
+    }
+
+
+    ResultCode HalfSpectrumImageWx::GetHalfSpectrumView(MatrixView<const std::complex<double>>& view, int& width) const {
+        view = m_mat.View();
+        width = m_width;
+        return ResultCode::ok;
+    }
+
+    ResultCode HalfSpectrumImageWx::GetHalfSpectrumView(MatrixView<const std::complex<float>>& view, int& width) const {
+        view = m_floatMat.View();
+        width = m_width;
+        return ResultCode::ok;
+    }
+
+    ResultCode HalfSpectrumImageWx::SetHalfSpectrum(matComplex&& mat, int width) {
+        if (!mat.Empty() && mat.Width() != width / 2 + 1)
+            return ResultCode::error;
+        m_mat = std::move(mat);
+        m_floatMat = matComplexFloat{};
+        m_width = m_mat.Empty() ? 0 : width;
+        m_cache = SpectrumCache{};
+        return ResultCode::ok;
+    }
+
+    ResultCode HalfSpectrumImageWx::SetHalfSpectrum(matComplexFloat&& mat, int width) {
+        if (!mat.Empty() && mat.Width() != width / 2 + 1)
+            return ResultCode::error;
+        m_floatMat = std::move(mat);
+        m_mat = matComplex{};
+        m_width = m_floatMat.Empty() ? 0 : width;
+        m_cache = SpectrumCache{};
+        return ResultCode::ok;
+    }
+
+    ResultCode HalfSpectrumImageWx::GetWxBitmap(wxBitmap& bitmap) {
+        if (m_width == 0) {
+            bitmap = wxBitmap(1, 1);
+            return ResultCode::error;
         }
-        return normalizedMat;
+        if (m_floatMat.Empty())
+            writeBitmap(m_mat, bitmap);
+        else
+            writeBitmap(m_floatMat, bitmap);
+        return ResultCode::ok;
     }
 
-    ResultCode ComplexGrayImageWx::Reset() {
+    ResultCode HalfSpectrumImageWx::GetLogWxBitmap(wxBitmap& bitmap) {
+        if (m_width == 0) {
+            bitmap = wxBitmap(1, 1);
+            return ResultCode::error;
+        }
+        if (m_floatMat.Empty())
+            writeLogBitmap(m_mat, bitmap);
+        else
+            writeLogBitmap(m_floatMat, bitmap);
+        return ResultCode::ok;
+    }
+
+    size_t HalfSpectrumImageWx::GetCacheBytes() const {
+        const matFloat& logMat{ m_cache.logMagnitude };
+        return static_cast<size_t>(logMat.Height()) * logMat.Stride() * sizeof(float);
+    }
+
+    ResultCode HalfSpectrumImageWx::ReleaseCache() {
+        // The norm range is a few bytes and kept.
+        m_cache.logMagnitude = matFloat{};
+        return ResultCode::ok;
+    }
+
+    ResultCode HalfSpectrumImageWx::Reset() {
         m_mat = matComplex{};
+        m_floatMat = matComplexFloat{};
+        m_width = 0;
+        m_cache = SpectrumCache{};
         return ResultCode::ok;
     }
 
-    double ComplexGrayImageWx::getMax() {
-        double maxVal{ m_mat[0][0].real()*m_mat[0][0].real() + m_mat[0][0].imag()*m_mat[0][0].imag() };
-        for (auto& row : m_mat) {
-            for (auto& el : row) {
-                maxVal = std::max(maxVal, sqrt(el.real()*el.real() + el.imag()*el.imag()));
-            }
+    template <typename T>
+    void HalfSpectrumImageWx::writeBitmap(const Matrix<std::complex<T>>& halfMat, wxBitmap& bitmap) {
+        // The mirrored columns repeat magnitudes of the half, so its range is that of the full spectrum.
+        if (!m_cache.hasNormRange) {
+            std::tie(m_cache.minNorm, m_cache.maxNorm) = matrixMinMax(halfMat.Height(), halfMat.Width(), [&halfMat](int i) {
+                const std::complex<T>* row{ halfMat[i] };
+                return rowMinMax(halfMat.Width(), [row](int j) { return static_cast<double>(row[j].real()) * row[j].real() + static_cast<double>(row[j].imag()) * row[j].imag(); });
+            });
+            m_cache.hasNormRange = true;
         }
-        return maxVal;
-    }   
 
-    double ComplexGrayImageWx::getMin() {
-        double minVal{ m_mat[0][0].real()*m_mat[0][0].real() + m_mat[0][0].imag()*m_mat[0][0].imag() };
-        for (auto& row : m_mat) {
-            for (auto& el : row) {
-                minVal = std::min(minVal, sqrt(el.real()*el.real() + el.imag()*el.imag()));
+        // Squared magnitudes over the squared range of the magnitudes, clipped to white.
+        double range{ std::sqrt(m_cache.maxNorm) - std::sqrt(m_cache.minNorm) };
+        double scale{ range > 0 ? 255.0 / (range * range) : 0.0 };
+        wxBitmap matBitmap(m_width, halfMat.Height(), 24);
+        writeCenteredSpectrum(matBitmap, halfMat, m_width, [scale](const std::complex<T>& value) {
+            double norm{ static_cast<double>(value.real()) * value.real() + static_cast<double>(value.imag()) * value.imag() };
+            return static_cast<unsigned char>(std::min(norm * scale, 255.0));
+        });
+        bitmap = matBitmap;
+    }
+
+    template <typename T>
+    void HalfSpectrumImageWx::writeLogBitmap(const Matrix<std::complex<T>>& halfMat, wxBitmap& bitmap) {
+        // The map of the half and its range in one pass, the bitmap mirrors it like the spectrum.
+        if (m_cache.logMagnitude.Empty()) {
+            matFloat logMat{ m_pool != nullptr ? matFloat(*m_pool, halfMat.Height(), halfMat.Width()) : matFloat(halfMat.Height(), halfMat.Width()) };
+            std::tie(m_cache.minLog, m_cache.maxLog) = matrixMinMax(halfMat.Height(), halfMat.Width(), [&halfMat, &logMat](int i) {
+                const std::complex<T>* row{ halfMat[i] };
+                float* logRow{ logMat[i] };
+                for (int j = 0; j < halfMat.Width(); j++) {
+                    double norm{ static_cast<double>(row[j].real()) * row[j].real() + static_cast<double>(row[j].imag()) * row[j].imag() };
+                    logRow[j] = static_cast<float>(std::log2(1.0 + std::sqrt(norm)));
+                }
+                return rowMinMax(halfMat.Width(), [logRow](int j) { return static_cast<double>(logRow[j]); });
+            });
+            m_cache.logMagnitude = std::move(logMat);
+        }
+
+        double minLog{ m_cache.minLog };
+        double range{ m_cache.maxLog - m_cache.minLog };
+        wxBitmap matBitmap(m_width, halfMat.Height(), 24);
+        writeCenteredSpectrum(matBitmap, m_cache.logMagnitude, m_width, [minLog, range](float value) {
+            return range > 0 ? static_cast<unsigned char>((value - minLog) / range * 255) : 0;
+        });
+        bitmap = matBitmap;
+    }
+
+    ResultCode RealRgbImageWx::LoadFromFile(std::string path) {
+        wxImage image;
+        if (!loadImage(path, image))
+            return ResultCode::error;
+
+        const int height{ image.GetHeight() };
+        const int width{ image.GetWidth() };
+        matRgb loadedMat{ makeMat(height, width), makeMat(height, width), makeMat(height, width) };
+        readRows(image, [&loadedMat, width](int row, const unsigned char* rgb) {
+            double* red{ loadedMat[0][row] };
+            double* green{ loadedMat[1][row] };
+            double* blue{ loadedMat[2][row] };
+            for (int j = 0; j < width; j++) {
+                red[j] = rgb[3 * j];
+                green[j] = rgb[3 * j + 1];
+                blue[j] = rgb[3 * j + 2];
             }
+        });
+        m_mat = std::move(loadedMat);
+        return ResultCode::ok;
+    }
+
+    ResultCode RealRgbImageWx::SaveAsFile(std::string path) {
+        return ResultCode::error;
+    }
+
+    ResultCode RealRgbImageWx::SetRgbImageMat(const matRgb& mat) {
+        return SetRgbImageMat(matRgb{ mat });
+    }
+
+    ResultCode RealRgbImageWx::GetRgbImageMat(matRgb& mat) {
+        mat = m_mat;
+        return ResultCode::ok;
+    }
+
+    ResultCode RealRgbImageWx::GetRgbImageView(rgbView& view) const {
+        for (int c = 0; c < 3; c++)
+            view[c] = m_mat[c].View();
+        return ResultCode::ok;
+    }
+
+    ResultCode RealRgbImageWx::SetRgbImageMat(matRgb&& mat) {
+        for (int c = 1; c < 3; c++) {
+            if (mat[c].Height() != mat[0].Height() || mat[c].Width() != mat[0].Width())
+                return ResultCode::invalidInput;
+        }
+        m_mat = std::move(mat);
+        return ResultCode::ok;
+    }
+
+    ResultCode RealRgbImageWx::GetWxBitmap(wxBitmap& bitmap) {
+        if (m_mat[0].Empty()) {
+            bitmap = wxBitmap(1, 1);
+            return ResultCode::error;
         }
-        return minVal;
+
+        const int height{ m_mat[0].Height() };
+        const int width{ m_mat[0].Width() };
+        auto [minVal, maxVal] { matrixMinMax(height, width, [this, width](int i) {
+            std::pair<double, double> minMax{ rowMinMax(width, [row = m_mat[0][i]](int j) { return row[j]; }) };
+            for (int c = 1; c < 3; c++) {
+                auto [rowMin, rowMax] { rowMinMax(width, [row = m_mat[c][i]](int j) { return row[j]; }) };
+                minMax = { std::min(minMax.first, rowMin), std::max(minMax.second, rowMax) };
+            }
+            return minMax;
+        }) };
+        double range{ maxVal - minVal };
+
+        // The same levels as a gray image, each channel from its own plane.
+        wxBitmap matBitmap(width, height, 24);
+        writeRgbPixels(matBitmap, height, width, [this, width, minVal, range](int i, unsigned char* red, unsigned char* green, unsigned char* blue) {
+            unsigned char* levels[3]{ red, green, blue };
+            for (int c = 0; c < 3; c++) {
+                const double* row{ m_mat[c][i] };
+                for (int j = 0; j < width; j++)
+                    levels[c][j] = range > 0 ? static_cast<unsigned char>((row[j] - minVal) / range * 255) : 0;
+            }
+        });
+        bitmap = matBitmap;
+        return ResultCode::ok;
     }
 
-   
+    ResultCode RealRgbImageWx::Reset() {
+        m_mat = matRgb{};
+        return ResultCode::ok;
+    }
 
+    mat RealRgbImageWx::makeMat(int height, int width) {
+        return m_pool != nullptr ? mat(*m_pool, height, width) : mat(height, width);
+    }
 }
\ No newline at end of file
@@ -7,6 +7,7 @@ namespace Image {
 
     class IWxBitmapLoader {
     public:
+        virtual ~IWxBitmapLoader() {};
         virtual ResultCode GetWxBitmap(wxBitmap& bitmap) = 0;
     };
 
@@ -14,37 +15,130 @@ namespace Image {
 
     class IComplexGrayImageWx : public ILoader, public IResetter, public IComplexGrayImage, public IWxBitmapLoader {};
 
+    class IHalfSpectrumImageWx : public IResetter, public IHalfSpectrumImage, public IWxBitmapLoader {
+    public:
+        /**
+        * Bitmap of log2(1 + magnitude), scaled by its range.
+        */
+        virtual ResultCode GetLogWxBitmap(wxBitmap& bitmap) = 0;
+
+        /**
+        * Memory held for the bitmaps on top of the spectrum, and its release. It is rebuilt on next use.
+        */
+        virtual size_t GetCacheBytes() const = 0;
+        virtual ResultCode ReleaseCache() = 0;
+    };
+
+    class IRealRgbImageWx : public ILoader, public IResetter, public IRealRgbImage, public IWxBitmapLoader {};
+
     class RealGrayImageWx : public IRealGrayImageWx {
     public:
         RealGrayImageWx() {};
+        // Buffers are taken from 'pool', which must outlive the image.
+        explicit RealGrayImageWx(BufferPool& pool) : m_pool{ &pool } {};
         ~RealGrayImageWx() {};
         ResultCode LoadFromFile(std::string path) override;
         ResultCode SaveAsFile(std::string path) override;
         ResultCode SetGrayImageMat(const mat& mat) override;
         ResultCode GetGrayImageMat(mat& mat) override;
+        ResultCode GetGrayImageView(MatrixView<const double>& view) const override;
+        ResultCode SetGrayImageMat(mat&& mat) override;
+        ResultCode TakeGrayImageMat(mat& mat) override;
+        ResultCode GetGrayImageShared(sharedMat& shared) const override;
+        ResultCode SetGrayImageShared(const sharedMat& shared) override;
+        ResultCode GetGrayImageView(MatrixView<const float>& view) const override;
+        ResultCode SetGrayImageMat(matFloat&& mat) override;
         ResultCode GetWxBitmap(wxBitmap& bitmap) override;
         ResultCode Reset() override;
     private:
-        mat getNormalizedMat();
-        double getMax();
-        double getMin();
-        mat m_mat{};
+        mat makeMat(int height, int width);
+        sharedMat m_mat{};
+        matFloat m_floatMat{};          // Set instead of m_mat for single precision images.
+        BufferPool* m_pool{ nullptr };
     };
 
     class ComplexGrayImageWx : public IComplexGrayImageWx {
     public:
         ComplexGrayImageWx() {};
+        explicit ComplexGrayImageWx(BufferPool& pool) : m_pool{ &pool } {};
         ~ComplexGrayImageWx() {};
         ResultCode LoadFromFile(std::string path) override;
         ResultCode SaveAsFile(std::string path) override;
         ResultCode SetGrayImageComplexMat(const matComplex& mat) override;
         ResultCode GetGrayImageComplexMat(matComplex& mat) override;
+        ResultCode GetGrayImageComplexView(MatrixView<const std::complex<double>>& view) const override;
+        ResultCode SetGrayImageComplexMat(matComplex&& mat) override;
+        ResultCode TakeGrayImageComplexMat(matComplex& mat) override;
+        ResultCode GetGrayImageComplexShared(sharedMatComplex& shared) const override;
+        ResultCode SetGrayImageComplexShared(const sharedMatComplex& shared) override;
         ResultCode GetWxBitmap(wxBitmap& bitmap) override;
         ResultCode Reset() override;
     private:
-        matComplex getNormalizedMat();
-        double getMax();
-        double getMin();
+        matComplex makeMat(int height, int width);
+        sharedMatComplex m_mat{};
+        BufferPool* m_pool{ nullptr };
+    };
+
+    /**
+    * What the bitmaps of a spectrum need of it, computed on first use after each change to it.
+    */
+    struct SpectrumCache {
+        bool hasNormRange{ false };
+        double minNorm{};                   // Smallest and largest squared magnitude.
+        double maxNorm{};
+        Matrix<float> logMagnitude{};       // log2(1 + magnitude), display precision.
+        double minLog{};
+        double maxLog{};
+    };
+
+    /**
+    * Half spectrum of a real image. The bitmaps show the full spectrum with frequency 0 at the
+    * center, the columns past the half read from their mirrors, which have the same magnitude.
+    */
+    class HalfSpectrumImageWx : public IHalfSpectrumImageWx {
+    public:
+        HalfSpectrumImageWx() {};
+        explicit HalfSpectrumImageWx(BufferPool& pool) : m_pool{ &pool } {};
+        ~HalfSpectrumImageWx() {};
+        ResultCode GetHalfSpectrumView(MatrixView<const std::complex<double>>& view, int& width) const override;
+        ResultCode GetHalfSpectrumView(MatrixView<const std::complex<float>>& view, int& width) const override;
+        ResultCode SetHalfSpectrum(matComplex&& mat, int width) override;
+        ResultCode SetHalfSpectrum(matComplexFloat&& mat, int width) override;
+        ResultCode GetWxBitmap(wxBitmap& bitmap) override;
+        ResultCode GetLogWxBitmap(wxBitmap& bitmap) override;
+        size_t GetCacheBytes() const override;
+        ResultCode ReleaseCache() override;
+        ResultCode Reset() override;
+    private:
+        template <typename T> void writeBitmap(const Matrix<std::complex<T>>& halfMat, wxBitmap& bitmap);
+        template <typename T> void writeLogBitmap(const Matrix<std::complex<T>>& halfMat, wxBitmap& bitmap);
         matComplex m_mat{};
+        matComplexFloat m_floatMat{};   // Set instead of m_mat for single precision spectra.
+        int m_width{ 0 };
+        SpectrumCache m_cache{};        // Of the half only.
+        BufferPool* m_pool{ nullptr };
+    };
+
+    /**
+    * Colour image in three planes. The bitmap is scaled by the range of all planes together,
+    * which keeps the colour balance.
+    */
+    class RealRgbImageWx : public IRealRgbImageWx {
+    public:
+        RealRgbImageWx() {};
+        explicit RealRgbImageWx(BufferPool& pool) : m_pool{ &pool } {};
+        ~RealRgbImageWx() {};
+        ResultCode LoadFromFile(std::string path) override;
+        ResultCode SaveAsFile(std::string path) override;
+        ResultCode SetRgbImageMat(const matRgb& mat) override;
+        ResultCode GetRgbImageMat(matRgb& mat) override;
+        ResultCode GetRgbImageView(rgbView& view) const override;
+        ResultCode SetRgbImageMat(matRgb&& mat) override;
+        ResultCode GetWxBitmap(wxBitmap& bitmap) override;
+        ResultCode Reset() override;
+    private:
+        mat makeMat(int height, int width);
+        matRgb m_mat{};
+        BufferPool* m_pool{ nullptr };
     };
 }
\ No newline at end of file
@@ -97,6 +97,17 @@ MainFrame::MainFrame(const wxString& title, const wxPoint& pos, const wxSize& si
     filterPassMode = new wxRadioBox(this, wxID_ANY, "Filter Pass Mode", wxDefaultPosition, wxDefaultSize, 2, choices, 1, wxRA_SPECIFY_COLS);
     filterPassMode->Bind(wxEVT_RADIOBOX, &MainFrame::OnChangeScaleOption, this);
 
+    choices[0] = wxString("Double"); choices[1] = wxString("Float");
+    precisionOptions = new wxRadioBox(this, wxID_ANY, "FFT Precision", wxDefaultPosition, wxDefaultSize, 2, choices, 2, wxRA_SPECIFY_COLS);
+    precisionOptions->Bind(wxEVT_RADIOBOX, &MainFrame::OnChangePrecision, this);
+    comparePrecisionButton = new wxButton(this, wxID_ANY, "Compare");
+    comparePrecisionButton->Bind(wxEVT_BUTTON, &MainFrame::OnComparePrecision, this);
+    precisionReportTxt = new wxStaticText(this, wxID_ANY, "");
+
+    choices[0] = wxString("Gray"); choices[1] = wxString("Colour");
+    colourOptions = new wxRadioBox(this, wxID_ANY, "Image Mode", wxDefaultPosition, wxDefaultSize, 2, choices, 2, wxRA_SPECIFY_COLS);
+    colourOptions->Bind(wxEVT_RADIOBOX, &MainFrame::OnChangeColourMode, this);
+
     controlsGridBagSizer->Add(loadImageTxt, wxGBPosition(0, 0), wxGBSpan(1, 1));
     controlsGridBagSizer->Add(imageNameTxtCtrl, wxGBPosition(1, 0), wxGBSpan(1, 2), wxEXPAND);
     controlsGridBagSizer->Add(loadImageButton, wxGBPosition(1, 2), wxGBSpan(1, 1), wxEXPAND | wxLEFT | wxRIGHT, FromDIP(5));
@@ -116,6 +127,12 @@ MainFrame::MainFrame(const wxString& title, const wxPoint& pos, const wxSize& si
     controlsGridBagSizer->Add(computeIDFTButton, wxGBPosition(9, 2), wxGBSpan(1, 1), wxALL, FromDIP(5));
     controlsGridBagSizer->Add(new wxStaticText(this, wxID_ANY, "Filter Area Size:"), wxGBPosition(10, 1), wxGBSpan(1, 1), wxEXPAND| wxALIGN_CENTER_HORIZONTAL | wxTOP, FromDIP(25));
     controlsGridBagSizer->Add(areaSlider, wxGBPosition(11, 0), wxGBSpan(1, 3), wxEXPAND);
+    controlsGridBagSizer->Add(new wxStaticLine(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxLI_HORIZONTAL), wxGBPosition(12, 0), wxGBSpan(1, 3), wxEXPAND | wxALL, FromDIP(15));
+    controlsGridBagSizer->Add(precisionOptions, wxGBPosition(13, 0), wxGBSpan(1, 2), wxEXPAND);
+    controlsGridBagSizer->Add(comparePrecisionButton, wxGBPosition(13, 2), wxGBSpan(1, 1), wxEXPAND | wxALL, FromDIP(5));
+    controlsGridBagSizer->Add(precisionReportTxt, wxGBPosition(14, 0), wxGBSpan(1, 3), wxEXPAND | wxTOP, FromDIP(5));
+    controlsGridBagSizer->Add(new wxStaticLine(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxLI_HORIZONTAL), wxGBPosition(15, 0), wxGBSpan(1, 3), wxEXPAND | wxALL, FromDIP(15));
+    controlsGridBagSizer->Add(colourOptions, wxGBPosition(16, 0), wxGBSpan(1, 3), wxEXPAND);
 
 
     mainSizer->Add(imageGridSizer, 3, wxSHAPED | wxALIGN_CENTER | wxALL, FromDIP(10));
@@ -126,30 +143,25 @@ MainFrame::MainFrame(const wxString& title, const wxPoint& pos, const wxSize& si
 }
 
 void MainFrame::OnOpenImage(wxCommandEvent& event) {
-    wxFileDialog openFileDialog(this, _("Open Image"), "", "", "Image files (*.png; *jpg; *jpeg; *.bmp)|*.png; *jpg; *jpeg; *.bmp");
+    wxFileDialog openFileDialog(this, _("Open Image"), "", "", "Image files (*.png; *jpg; *jpeg; *.bmp)|*.png; *jpg; *jpeg; *.bmp|Raw frames (*.pgm; *.pfm; *.npy; *.raw)|*.pgm; *.pfm; *.npy; *.raw");
 
     if (openFileDialog.ShowModal() == wxID_CANCEL) 
         return;
     std::string path = static_cast<std::string>(openFileDialog.GetPath());
     imageNameTxtCtrl->SetValue(path);
     imgFilter.LoadFromFile(path);
+    if (colourMode())
+        loadColourPlanes(path);
 
- 
+    refreshPanels();
     wxBitmap bmp{ imgFilter.NoisyImageBmp() };
-    imgBitmap->SetBitmap(bmp);
     resizeWidthTxtCtrl->SetValue(std::format("{}", bmp.GetWidth()));
     resizeHeightTxtCtrl->SetValue(std::format("{}", bmp.GetHeight()));
-    dftBitmap->SetBitmap(wxBitmap(1, 1));
-    filteredImgBitmap->SetBitmap(wxBitmap(1, 1));
-    idftBitmap->SetBitmap(wxBitmap(1, 1));
 }
 
 void MainFrame::OnComputeDFT(wxCommandEvent& event) {
     imgFilter.ComputeFourierTransform();
-    int sel{ dftScaleOptions->GetSelection() };
-    changeScale(static_cast<scaleMode>(sel));
-    filteredImgBitmap->SetBitmap(wxBitmap(1, 1));
-    idftBitmap->SetBitmap(wxBitmap(1, 1));
+    refreshPanels();
 }
 
 
@@ -159,19 +171,19 @@ void MainFrame::OnComputeIDFT(wxCommandEvent& event) {
     switch (sel) {
         case 0: {
             imgFilter.ApplyFilterMask(maskSize, ImageFilter::FilterPassMode::low);
+            if (colourMode())
+                imgFilter.ApplyRgbFilterMask(maskSize, ImageFilter::FilterPassMode::low);
             break;
         }
         case 1: {
             imgFilter.ApplyFilterMask(maskSize, ImageFilter::FilterPassMode::high);
+            if (colourMode())
+                imgFilter.ApplyRgbFilterMask(maskSize, ImageFilter::FilterPassMode::high);
             break;
         }
     }
     imgFilter.ComputeInverseFourierTransform();
-    sel = dftScaleOptions->GetSelection();
-    changeScale(static_cast<scaleMode>(sel));
-    wxBitmap bmp{ imgFilter.ProccessedImageBmp() };
-    idftBitmap->SetBitmap(bmp);
-
+    refreshPanels();
 }
 
 
@@ -181,9 +193,7 @@ void MainFrame::OnAddNoise(wxCommandEvent& event) {
         return;
     }
     imgFilter.AddNoise(percent);
-    wxBitmap bmp{ imgFilter.NoisyImageBmp() };
-    imgBitmap->SetBitmap(bmp);
-    
+    refreshPanels();
 }
 
 void MainFrame::OnResizeImage(wxCommandEvent& event) {
@@ -208,41 +218,86 @@ void MainFrame::OnResizeImage(wxCommandEvent& event) {
     }
   
     //
+    refreshPanels();
     wxBitmap bmp{ imgFilter.NoisyImageBmp() };
-    imgBitmap->SetBitmap(bmp);
     resizeWidthTxtCtrl->SetValue(std::format("{}", bmp.GetWidth()));
     resizeHeightTxtCtrl->SetValue(std::format("{}", bmp.GetHeight()));
     // TODO: Resize Image event to mediator
     // 
     // wxMessageBox( wxT("OnResizeImage"), wxT("OnResizeImage"), wxICON_INFORMATION);
-    dftBitmap->SetBitmap(wxBitmap(1,1));
-    filteredImgBitmap->SetBitmap(wxBitmap(1, 1));
-    idftBitmap->SetBitmap(wxBitmap(1, 1));
 }
 
 
 void MainFrame::OnChangeScaleOption(wxCommandEvent& event) {
-    int sel{ dftScaleOptions->GetSelection() };
-    changeScale(static_cast<scaleMode>(sel));
+    refreshPanels();
+}
+
+void MainFrame::OnChangePrecision(wxCommandEvent& event) {
+    int sel{ precisionOptions->GetSelection() };
+    switch (sel) {
+        case 0: {
+            imgFilter.SetTransformPrecision(ImageFilter::TransformPrecision::float64);
+            break;
+        }
+        case 1: {
+            imgFilter.SetTransformPrecision(ImageFilter::TransformPrecision::float32);
+            break;
+        }
+    }
+}
+
+void MainFrame::OnChangeColourMode(wxCommandEvent& event) {
+    // The colour planes are only loaded in colour mode, from the image already opened.
+    std::string path = static_cast<std::string>(imageNameTxtCtrl->GetValue());
+    if (colourMode() && !path.empty())
+        loadColourPlanes(path);
+    refreshPanels();
 }
 
-void MainFrame::changeScale(scaleMode mode) {
-    switch (mode) {
+void MainFrame::loadColourPlanes(const std::string& path) {
+    // Raw gray frames have no colour planes, the panels go back to gray rather than show another image.
+    if (imgFilter.LoadRgbFromFile(path) != Image::ResultCode::ok)
+        colourOptions->SetSelection(0);
+}
+
+bool MainFrame::colourMode() const {
+    return colourOptions->GetSelection() == 1;
+}
+
+void MainFrame::OnComparePrecision(wxCommandEvent& event) {
+    ImageFilter::PrecisionReport report{ imgFilter.ComparePrecision() };
+    precisionReportTxt->SetLabel(std::format("Float vs double:\n  spectrum rel. RMS error {:.2e}\n  image max error {:.2e}, RMS error {:.2e}",
+                                             report.spectrumRelativeRms, report.imageMaxError, report.imageRmsError));
+    Layout();
+}
+
+void MainFrame::refreshPanels() {
+    ImageFilter::BitmapScale scale{ ImageFilter::BitmapScale::linear };
+    switch (static_cast<scaleMode>(dftScaleOptions->GetSelection())) {
         case scaleMode::normal: {
-            wxBitmap bmp{ imgFilter.DFTImageBmp() };
-            dftBitmap->SetBitmap(bmp);
-            bmp = imgFilter.MaskedDFTImageBmp();
-            filteredImgBitmap->SetBitmap(bmp);
+            scale = ImageFilter::BitmapScale::linear;
             break;
         }
         case scaleMode::log2: {
-            wxBitmap bmp{ imgFilter.LogDFTImageBmp() };
-            dftBitmap->SetBitmap(bmp);
-            bmp = imgFilter.LogMaskedDFTImageBmp();
-            filteredImgBitmap->SetBitmap(bmp);
+            scale = ImageFilter::BitmapScale::log2;
             break;
         }
     }
+    // In colour mode the spectra are still those of the gray image, the mask is the same for all planes.
+    bool colour{ colourMode() };
+    showStage(imgBitmap, imgShown, colour ? ImageFilter::Stage::rgb : ImageFilter::Stage::noisy, ImageFilter::BitmapScale::linear);
+    showStage(dftBitmap, dftShown, ImageFilter::Stage::dft, scale);
+    showStage(filteredImgBitmap, filteredImgShown, ImageFilter::Stage::maskedDft, scale);
+    showStage(idftBitmap, idftShown, colour ? ImageFilter::Stage::processedRgb : ImageFilter::Stage::processed, ImageFilter::BitmapScale::linear);
+}
+
+void MainFrame::showStage(BufferedBitmap* panel, ShownStage& shown, ImageFilter::Stage stage, ImageFilter::BitmapScale scale) {
+    // Panels whose stage has not changed since they were drawn keep their bitmap.
+    ShownStage current{ true, stage, imgFilter.GetStageVersion(stage), scale };
+    if (shown.valid && shown.stage == current.stage && shown.version == current.version && shown.scale == current.scale)
+        return;
+    panel->SetBitmap(imgFilter.StageBitmap(stage, scale));
+    shown = current;
 }
 
 void MainFrame::OnAreaChange(wxScrollEvent& event) {
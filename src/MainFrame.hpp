@@ -26,6 +26,18 @@ private:
 	BufferedBitmap* filteredImgBitmap{};
 	BufferedBitmap* idftBitmap{};
 
+	// Stage, version and scale last drawn on each panel.
+	struct ShownStage {
+		bool valid{ false };
+		ImageFilter::Stage stage{ ImageFilter::Stage::original };
+		uint64_t version{ 0 };
+		ImageFilter::BitmapScale scale{ ImageFilter::BitmapScale::linear };
+	};
+	ShownStage imgShown{};
+	ShownStage dftShown{};
+	ShownStage filteredImgShown{};
+	ShownStage idftShown{};
+
 
 	wxTextCtrl* noisePercentTxtCtrl{};
 	wxTextCtrl* resizeWidthTxtCtrl{};
@@ -37,10 +49,15 @@ private:
 	wxButton* addNoiseButton{};
 	wxButton* computeDFTButton{};
 	wxButton* computeIDFTButton{};
+	wxButton* comparePrecisionButton{};
 
 	wxRadioBox* resizeOptions{};
 	wxRadioBox* dftScaleOptions{};
 	wxRadioBox* filterPassMode{};
+	wxRadioBox* precisionOptions{};
+	wxRadioBox* colourOptions{};
+
+	wxStaticText* precisionReportTxt{};
 
 	wxSlider* areaSlider{};
 
@@ -49,10 +66,16 @@ private:
 	void OnAddNoise(wxCommandEvent& event);
 	
 	void OnChangeScaleOption(wxCommandEvent& event);
+	void OnChangePrecision(wxCommandEvent& event);
+	void OnChangeColourMode(wxCommandEvent& event);
+	void OnComparePrecision(wxCommandEvent& event);
 	void OnAreaChange(wxScrollEvent& event);
 	
 	void OnOpenImage(wxCommandEvent& event);
 	void OnResizeImage(wxCommandEvent& event);
-	void changeScale(scaleMode mode);
+	void refreshPanels();
+	bool colourMode() const;
+	void loadColourPlanes(const std::string& path);
+	void showStage(BufferedBitmap* panel, ShownStage& shown, ImageFilter::Stage stage, ImageFilter::BitmapScale scale);
 };
 
@@ -0,0 +1,443 @@
+#include "MappedImage.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <regex>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Image {
+
+    namespace {
+        // Rows of at least this many pixels together are worth a thread, as in ImageWx.cpp.
+        constexpr int pixelGrain{ 1 << 16 };
+
+        int rowGrain(int width) {
+            return std::max(1, pixelGrain / std::max(width, 1));
+        }
+
+        /**
+        * Read-only mapping of a whole file, unmapped on destruction. Data() is nullptr if the file
+        * could not be opened or mapped, or is empty.
+        */
+        class MappedFile {
+        public:
+            explicit MappedFile(const std::string& path) {
+#if defined(_WIN32)
+                HANDLE file{ CreateFileW(std::filesystem::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                         FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+                if (file == INVALID_HANDLE_VALUE)
+                    return;
+                LARGE_INTEGER size{};
+                if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+                    // The view keeps the file open, the handles are not needed once it is mapped.
+                    HANDLE mapping{ CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+                    if (mapping != nullptr) {
+                        m_data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                        m_size = m_data != nullptr ? static_cast<size_t>(size.QuadPart) : 0;
+                        CloseHandle(mapping);
+                    }
+                }
+                CloseHandle(file);
+#else
+                int file{ open(path.c_str(), O_RDONLY) };
+                if (file < 0)
+                    return;
+                struct stat info {};
+                if (fstat(file, &info) == 0 && info.st_size > 0) {
+                    void* data{ mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0) };
+                    if (data != MAP_FAILED) {
+                        m_data = static_cast<const unsigned char*>(data);
+                        m_size = static_cast<size_t>(info.st_size);
+                    }
+                }
+                close(file);
+#endif
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            ~MappedFile() {
+                if (m_data == nullptr)
+                    return;
+#if defined(_WIN32)
+                UnmapViewOfFile(m_data);
+#else
+                munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+            }
+
+            const unsigned char* Data() const { return m_data; }
+            size_t Size() const { return m_size; }
+
+        private:
+            const unsigned char* m_data{ nullptr };
+            size_t m_size{ 0 };
+        };
+
+        enum class SampleType {
+            u8,
+            u16,
+            i16,
+            f32,
+            f64,
+        };
+
+        size_t sampleSize(SampleType type) {
+            switch (type) {
+                case SampleType::u8: {
+                    return 1;
+                }
+                case SampleType::u16:
+                case SampleType::i16: {
+                    return 2;
+                }
+                case SampleType::f32: {
+                    return 4;
+                }
+                case SampleType::f64: {
+                    return 8;
+                }
+            }
+            return 1;
+        }
+
+        /**
+        * Where and how the samples of a frame lie in the file.
+        */
+        struct FrameLayout {
+            size_t offset{ 0 };         // Bytes before the first sample.
+            int height{ 0 };
+            int width{ 0 };
+            SampleType type{ SampleType::u8 };
+            bool bigEndian{ false };
+            bool bottomUp{ false };     // The first row in the file is the bottom row of the image.
+        };
+
+        bool parseInt(std::string_view text, int& value) {
+            const char* end{ text.data() + text.size() };
+            auto [last, error] { std::from_chars(text.data(), end, value) };
+            return error == std::errc{} && last == end;
+        }
+
+        /**
+        * Next whitespace separated token of a Netpbm header from 'pos', skipping '#' comments.
+        * 'pos' is left on the character after the token.
+        */
+        bool readToken(const unsigned char* data, size_t size, size_t& pos, std::string_view& token) {
+            while (pos < size) {
+                if (data[pos] == '#') {
+                    while (pos < size && data[pos] != '\n' && data[pos] != '\r')
+                        pos++;
+                }
+                else if (std::isspace(data[pos])) {
+                    pos++;
+                }
+                else {
+                    break;
+                }
+            }
+            size_t begin{ pos };
+            while (pos < size && !std::isspace(data[pos]))
+                pos++;
+            token = { reinterpret_cast<const char*>(data) + begin, pos - begin };
+            return !token.empty();
+        }
+
+        /**
+        * Binary PGM: "P5" width height maxval, one whitespace character, then the rows top down.
+        * 16-bit samples (maxval above 255) are big-endian.
+        */
+        bool parsePgm(const unsigned char* data, size_t size, FrameLayout& layout) {
+            size_t pos{ 0 };
+            std::string_view token{};
+            int maxValue{ 0 };
+            if (!readToken(data, size, pos, token) || token != "P5")
+                return false;
+            if (!readToken(data, size, pos, token) || !parseInt(token, layout.width))
+                return false;
+            if (!readToken(data, size, pos, token) || !parseInt(token, layout.height))
+                return false;
+            if (!readToken(data, size, pos, token) || !parseInt(token, maxValue) || maxValue <= 0 || maxValue > 65535)
+                return false;
+            layout.offset = pos + 1;
+            layout.type = maxValue < 256 ? SampleType::u8 : SampleType::u16;
+            layout.bigEndian = true;
+            layout.bottomUp = false;
+            return true;
+        }
+
+        /**
+        * Gray PFM: "Pf" width height scale, one whitespace character, then float rows bottom up.
+        * A negative scale marks little-endian samples.
+        */
+        bool parsePfm(const unsigned char* data, size_t size, FrameLayout& layout) {
+            size_t pos{ 0 };
+            std::string_view token{};
+            if (!readToken(data, size, pos, token) || token != "Pf")
+                return false;
+            if (!readToken(data, size, pos, token) || !parseInt(token, layout.width))
+                return false;
+            if (!readToken(data, size, pos, token) || !parseInt(token, layout.height))
+                return false;
+            if (!readToken(data, size, pos, token))
+                return false;
+            std::string scaleText{ token };
+            char* end{ nullptr };
+            double scale{ std::strtod(scaleText.c_str(), &end) };
+            if (end == scaleText.c_str() || scale == 0.0)
+                return false;
+            layout.offset = pos + 1;
+            layout.type = SampleType::f32;
+            layout.bigEndian = scale > 0.0;
+            layout.bottomUp = true;
+            return true;
+        }
+
+        /**
+        * Value of 'key' in the Python dict literal of a NPY header, up to the next ',' or '}' outside brackets.
+        */
+        std::string_view npyField(std::string_view header, std::string_view key) {
+            size_t pos{ header.find(key) };
+            if (pos == std::string_view::npos)
+                return {};
+            pos = header.find(':', pos + key.size());
+            if (pos == std::string_view::npos)
+                return {};
+            size_t begin{ header.find_first_not_of(' ', pos + 1) };
+            if (begin == std::string_view::npos)
+                return {};
+            size_t end{ header[begin] == '(' ? header.find(')', begin) : header.find_first_of(",}", begin) };
+            if (end == std::string_view::npos)
+                return {};
+            return header.substr(begin, end - begin + (header[begin] == '(' ? 1 : 0));
+        }
+
+        /**
+        * NPY: magic, version, header length, then a dict with 'descr', 'fortran_order' and 'shape'.
+        * Only 2-D arrays in C order, rows top down.
+        */
+        bool parseNpy(const unsigned char* data, size_t size, FrameLayout& layout) {
+            if (size < 10 || std::memcmp(data, "\x93NUMPY", 6) != 0)
+                return false;
+            size_t headerBegin{ data[6] == 1 ? size_t{ 10 } : size_t{ 12 } };
+            if (size < headerBegin)
+                return false;
+            size_t headerLength{ static_cast<size_t>(data[8]) | static_cast<size_t>(data[9]) << 8 };
+            if (data[6] != 1)
+                headerLength |= static_cast<size_t>(data[10]) << 16 | static_cast<size_t>(data[11]) << 24;
+            if (size < headerBegin + headerLength)
+                return false;
+            std::string_view header{ reinterpret_cast<const char*>(data) + headerBegin, headerLength };
+
+            if (npyField(header, "'fortran_order'").starts_with("True"))
+                return false;
+
+            // descr is quoted: byte order, kind and size, e.g. '<u2'.
+            std::string_view descr{ npyField(header, "'descr'") };
+            if (descr.size() < 5 || descr.front() != '\'' || descr.back() != '\'')
+                return false;
+            char order{ descr[1] };
+            std::string_view kind{ descr.substr(2, descr.size() - 3) };
+            if (kind == "u1")
+                layout.type = SampleType::u8;
+            else if (kind == "u2")
+                layout.type = SampleType::u16;
+            else if (kind == "i2")
+                layout.type = SampleType::i16;
+            else if (kind == "f4")
+                layout.type = SampleType::f32;
+            else if (kind == "f8")
+                layout.type = SampleType::f64;
+            else
+                return false;
+            layout.bigEndian = order == '>' || (order == '=' && std::endian::native == std::endian::big);
+
+            // shape is a tuple, '(height, width)'.
+            std::string_view shape{ npyField(header, "'shape'") };
+            if (shape.size() < 2)
+                return false;
+            shape = shape.substr(1, shape.size() - 2);
+            size_t comma{ shape.find(',') };
+            if (comma == std::string_view::npos)
+                return false;
+            std::string_view heightText{ shape.substr(0, comma) };
+            std::string_view widthText{ shape.substr(comma + 1) };
+            if (widthText.ends_with(','))
+                widthText.remove_suffix(1);
+            auto trim{ [](std::string_view text) {
+                size_t begin{ text.find_first_not_of(' ') };
+                size_t end{ text.find_last_not_of(' ') };
+                return begin == std::string_view::npos ? std::string_view{} : text.substr(begin, end - begin + 1);
+            } };
+            if (!parseInt(trim(heightText), layout.height) || !parseInt(trim(widthText), layout.width))
+                return false;
+            layout.offset = headerBegin + headerLength;
+            layout.bottomUp = false;
+            return true;
+        }
+
+        /**
+        * Headerless samples, described by a name ending in _<width>x<height>_<u8|u16|f32>, rows top down.
+        */
+        bool parseRawName(const std::string& path, FrameLayout& layout) {
+            static const std::regex pattern{ R"(.*_(\d+)x(\d+)_(u8|u16|f32))" };
+            std::string stem{ std::filesystem::path(path).stem().string() };
+            std::smatch match{};
+            if (!std::regex_match(stem, match, pattern))
+                return false;
+            if (!parseInt(match.str(1), layout.width) || !parseInt(match.str(2), layout.height))
+                return false;
+            if (match.str(3) == "u8")
+                layout.type = SampleType::u8;
+            else if (match.str(3) == "u16")
+                layout.type = SampleType::u16;
+            else
+                layout.type = SampleType::f32;
+            layout.offset = 0;
+            layout.bigEndian = false;
+            layout.bottomUp = false;
+            return true;
+        }
+
+        std::string lowerExtension(const std::string& path) {
+            std::string extension{ std::filesystem::path(path).extension().string() };
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            return extension;
+        }
+
+        bool readLayout(const std::string& path, const MappedFile& file, FrameLayout& layout) {
+            std::string extension{ lowerExtension(path) };
+            bool parsed{ false };
+            if (extension == ".pgm")
+                parsed = parsePgm(file.Data(), file.Size(), layout);
+            else if (extension == ".pfm")
+                parsed = parsePfm(file.Data(), file.Size(), layout);
+            else if (extension == ".npy")
+                parsed = parseNpy(file.Data(), file.Size(), layout);
+            else if (extension == ".raw")
+                parsed = parseRawName(path, layout);
+            if (!parsed || layout.height <= 0 || layout.width <= 0)
+                return false;
+            // The samples must lie within the file.
+            size_t rowBytes{ static_cast<size_t>(layout.width) * sampleSize(layout.type) };
+            if (layout.offset > file.Size() || static_cast<size_t>(layout.height) > (file.Size() - layout.offset) / rowBytes)
+                return false;
+            return true;
+        }
+
+        /**
+        * 'width' samples of type T at 'samples', which need not be aligned, into 'row'.
+        * False if any of them is NaN or infinite.
+        */
+        template <typename T, bool SwapBytes>
+        bool convertSamples(const unsigned char* samples, int width, double* row) {
+            bool finite{ true };
+            for (int j = 0; j < width; j++) {
+                unsigned char bytes[sizeof(T)];
+                std::memcpy(bytes, samples + j * sizeof(T), sizeof(T));
+                if constexpr (SwapBytes)
+                    std::reverse(bytes, bytes + sizeof(T));
+                T value{};
+                std::memcpy(&value, bytes, sizeof(T));
+                row[j] = static_cast<double>(value);
+                if constexpr (std::is_floating_point_v<T>)
+                    finite = finite && std::isfinite(value);
+            }
+            return finite;
+        }
+
+        template <typename T>
+        bool convertRow(const unsigned char* samples, int width, bool swapBytes, double* row) {
+            if (swapBytes)
+                return convertSamples<T, true>(samples, width, row);
+            return convertSamples<T, false>(samples, width, row);
+        }
+    }
+
+    bool MappedGrayLoader::Supports(const std::string& path) {
+        std::string extension{ lowerExtension(path) };
+        return extension == ".pgm" || extension == ".pfm" || extension == ".npy" || extension == ".raw";
+    }
+
+    ResultCode MappedGrayLoader::LoadFromFile(std::string path) {
+        MappedFile file{ path };
+        if (file.Data() == nullptr)
+            return ResultCode::error;
+        FrameLayout layout{};
+        if (!readLayout(path, file, layout))
+            return ResultCode::invalidInput;
+
+        const int height{ layout.height };
+        const int width{ layout.width };
+        const size_t rowBytes{ static_cast<size_t>(width) * sampleSize(layout.type) };
+        const bool swapBytes{ layout.bigEndian != (std::endian::native == std::endian::big) };
+        const unsigned char* samples{ file.Data() + layout.offset };
+
+        // Converted into the double matrix the pipeline works on, a copy of every sample, on purpose:
+        // the mapping is only read once and released.
+        mat loadedMat{ m_pool != nullptr ? mat(*m_pool, height, width) : mat(height, width) };
+        std::atomic<bool> finite{ true };
+        FFT::ParallelFor(height, rowGrain(width), [&](int begin, int end) {
+            bool rowsFinite{ true };
+            for (int i = begin; i < end; i++) {
+                const unsigned char* rowSamples{ samples + i * rowBytes };
+                double* row{ loadedMat[layout.bottomUp ? i : height - 1 - i] };
+                switch (layout.type) {
+                    case SampleType::u8: {
+                        convertRow<uint8_t>(rowSamples, width, false, row);
+                        break;
+                    }
+                    case SampleType::u16: {
+                        convertRow<uint16_t>(rowSamples, width, swapBytes, row);
+                        break;
+                    }
+                    case SampleType::i16: {
+                        convertRow<int16_t>(rowSamples, width, swapBytes, row);
+                        break;
+                    }
+                    case SampleType::f32: {
+                        rowsFinite = convertRow<float>(rowSamples, width, swapBytes, row) && rowsFinite;
+                        break;
+                    }
+                    case SampleType::f64: {
+                        rowsFinite = convertRow<double>(rowSamples, width, swapBytes, row) && rowsFinite;
+                        break;
+                    }
+                }
+            }
+            if (!rowsFinite)
+                finite = false;
+        });
+        // NaN or infinite samples leave no range to scale the bitmaps and transforms by, the image is kept as it was.
+        if (!finite)
+            return ResultCode::invalidInput;
+        return m_image.SetGrayImageMat(std::move(loadedMat));
+    }
+
+    ResultCode MappedGrayLoader::SaveAsFile(std::string path) {
+        return ResultCode::error;
+    }
+}
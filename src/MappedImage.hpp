@@ -0,0 +1,41 @@
+#pragma once
+#include "Image.hpp"
+#include <string>
+
+namespace Image {
+
+    /**
+    * Loader of gray frames with 8-bit, 16-bit or floating point samples:
+    *   .pgm  binary PGM (P5), 8 or 16-bit.
+    *   .pfm  gray PFM (Pf), 32-bit float.
+    *   .npy  2-D NumPy array of u1, u2, i2, f4 or f8, C order.
+    *   .raw  headerless little-endian samples, size and type given by the file name as
+    *         <name>_<width>x<height>_<u8|u16|f32>.raw, e.g. frame_640x480_u16.raw.
+    * The file is memory-mapped and read once: every sample is converted to double, rows in
+    * parallel, into the image matrix. That conversion is a full copy, made on purpose since the
+    * whole pipeline works on double images; the mapping only saves the read buffer of a stream.
+    * Sample values are kept as they are, not scaled to 8 bits. Rows are stored bottom up, the same
+    * as the images loaded through wx. Float frames with NaN or infinite samples are rejected with
+    * invalidInput.
+    */
+    class MappedGrayLoader : public ILoader {
+    public:
+        // Loads into 'image'.
+        explicit MappedGrayLoader(IRealGrayImage& image) : m_image{ image } {};
+        // Loads into 'image', with the matrix taken from 'pool', which must outlive the image.
+        MappedGrayLoader(IRealGrayImage& image, BufferPool& pool) : m_image{ image }, m_pool{ &pool } {};
+        ~MappedGrayLoader() {};
+
+        /**
+        * True if 'path' has one of the extensions above.
+        */
+        static bool Supports(const std::string& path);
+
+        ResultCode LoadFromFile(std::string path) override;
+        ResultCode SaveAsFile(std::string path) override;
+
+    private:
+        IRealGrayImage& m_image;
+        BufferPool* m_pool{ nullptr };
+    };
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include "BufferPool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace Image {
+
+    /**
+    * Non-owning view of a matrix, rows Stride() elements apart. Views of a Matrix stay valid
+    * until it is resized, assigned or destroyed.
+    */
+    template <typename T>
+    class MatrixView {
+    public:
+        MatrixView() = default;
+        MatrixView(T* data, int height, int width, ptrdiff_t stride) : m_data{ data }, m_height{ height }, m_width{ width }, m_stride{ stride } {};
+
+        // Read-only view of the same elements.
+        operator MatrixView<const T>() const { return { m_data, m_height, m_width, m_stride }; }
+
+        int Height() const { return m_height; }
+        int Width() const { return m_width; }
+        ptrdiff_t Stride() const { return m_stride; }
+        bool Empty() const { return m_height == 0 || m_width == 0; }
+        T* Data() const { return m_data; }
+
+        T* operator[](int row) const { return m_data + row * m_stride; }
+        std::span<T> Row(int row) const { return { (*this)[row], static_cast<size_t>(m_width) }; }
+
+        /**
+        * View of the sub-rectangle of 'height' rows and 'width' columns from ('top', 'left').
+        */
+        MatrixView<T> View(int top, int left, int height, int width) const {
+            return { (*this)[top] + left, height, width, m_stride };
+        }
+
+    private:
+        T* m_data{ nullptr };
+        int m_height{ 0 };
+        int m_width{ 0 };
+        ptrdiff_t m_stride{ 0 };
+    };
+
+    /**
+    * Matrix in a single 64-byte aligned buffer. Every row starts on a 64-byte boundary, so rows
+    * are padded to Stride() elements. Copies are deep, moves take the buffer. A matrix made from
+    * a BufferPool takes its buffer from the pool and gives it back when freed or reallocated, so
+    * the pool must outlive it.
+    */
+    template <typename T>
+    class Matrix {
+    public:
+        static constexpr size_t Alignment{ BufferPool::Alignment };
+        static_assert(Alignment % sizeof(T) == 0, "Rows of Matrix<T> are padded to whole elements of T.");
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "Matrix<T> copies elements as bytes.");
+
+        Matrix() = default;
+        Matrix(int height, int width, T value = T{}) { allocate(height, width); std::fill_n(m_data.get(), elementCount(), value); };
+        Matrix(BufferPool& pool, int height, int width, T value = T{}) : m_data{ nullptr, BufferDelete{ &pool } } {
+            allocate(height, width);
+            std::fill_n(m_data.get(), elementCount(), value);
+        };
+        Matrix(const Matrix& other) { *this = other; };
+        Matrix(Matrix&& other) noexcept { *this = std::move(other); };
+        ~Matrix() {};
+
+        Matrix& operator=(const Matrix& other) {
+            if (this == &other)
+                return *this;
+            if (m_height != other.m_height || m_width != other.m_width)
+                allocate(other.m_height, other.m_width);
+            if (elementCount() > 0)
+                std::memcpy(m_data.get(), other.m_data.get(), elementCount() * sizeof(T));
+            return *this;
+        }
+
+        Matrix& operator=(Matrix&& other) noexcept {
+            // The moved from matrix is left empty.
+            m_data = std::move(other.m_data);
+            m_height = std::exchange(other.m_height, 0);
+            m_width = std::exchange(other.m_width, 0);
+            m_stride = std::exchange(other.m_stride, 0);
+            return *this;
+        }
+
+        int Height() const { return m_height; }
+        int Width() const { return m_width; }
+        ptrdiff_t Stride() const { return m_stride; }
+        bool Empty() const { return m_height == 0 || m_width == 0; }
+        T* Data() { return m_data.get(); }
+        const T* Data() const { return m_data.get(); }
+
+        T* operator[](int row) { return m_data.get() + row * m_stride; }
+        const T* operator[](int row) const { return m_data.get() + row * m_stride; }
+        std::span<T> Row(int row) { return View().Row(row); }
+        std::span<const T> Row(int row) const { return View().Row(row); }
+
+        MatrixView<T> View() { return { m_data.get(), m_height, m_width, m_stride }; }
+        MatrixView<const T> View() const { return { m_data.get(), m_height, m_width, m_stride }; }
+        MatrixView<T> View(int top, int left, int height, int width) { return View().View(top, left, height, width); }
+        MatrixView<const T> View(int top, int left, int height, int width) const { return View().View(top, left, height, width); }
+
+    private:
+        struct BufferDelete {
+            BufferPool* pool{ nullptr };
+            size_t capacity{ 0 };
+            void operator()(T* data) const {
+                if (pool != nullptr)
+                    pool->Release(data, capacity);
+                else
+                    ::operator delete(data, std::align_val_t{ Alignment });
+            }
+        };
+
+        size_t elementCount() const { return static_cast<size_t>(m_height) * m_stride; }
+
+        void allocate(int height, int width) {
+            m_data.reset();
+            m_height = std::max(height, 0);
+            m_width = std::max(width, 0);
+            const ptrdiff_t rowAlignment{ static_cast<ptrdiff_t>(Alignment / sizeof(T)) };
+            m_stride = (m_width + rowAlignment - 1) / rowAlignment * rowAlignment;
+            if (elementCount() == 0)
+                return;
+            BufferDelete& buffer{ m_data.get_deleter() };
+            if (buffer.pool != nullptr)
+                m_data.reset(static_cast<T*>(buffer.pool->Acquire(elementCount() * sizeof(T), buffer.capacity)));
+            else
+                m_data.reset(static_cast<T*>(::operator new(elementCount() * sizeof(T), std::align_val_t{ Alignment })));
+        }
+
+        std::unique_ptr<T, BufferDelete> m_data{};
+        int m_height{ 0 };
+        int m_width{ 0 };
+        ptrdiff_t m_stride{ 0 };
+    };
+
+    /**
+    * Reference counted, copy-on-write Matrix. Copies share one buffer, which is read-only while
+    * shared; Mutable() first copies it out if another SharedMatrix still holds it.
+    */
+    template <typename T>
+    class SharedMatrix {
+    public:
+        SharedMatrix() = default;
+        explicit SharedMatrix(Matrix<T>&& matrix) : m_matrix{ std::make_shared<Matrix<T>>(std::move(matrix)) } {};
+
+        const Matrix<T>& Get() const {
+            static const Matrix<T> empty{};
+            return m_matrix ? *m_matrix : empty;
+        }
+        MatrixView<const T> View() const { return Get().View(); }
+        bool Empty() const { return Get().Empty(); }
+        // True if no other SharedMatrix holds the buffer.
+        bool Unique() const { return m_matrix.use_count() <= 1; }
+
+        /**
+        * Writable matrix, copied out of the shared buffer first if it is not unique.
+        */
+        Matrix<T>& Mutable() {
+            if (!m_matrix)
+                m_matrix = std::make_shared<Matrix<T>>();
+            else if (!Unique())
+                m_matrix = std::make_shared<Matrix<T>>(*m_matrix);
+            return *m_matrix;
+        }
+
+        /**
+        * Hand the matrix over and leave this empty. Moved out if unique, copied otherwise.
+        */
+        Matrix<T> Release() {
+            Matrix<T> matrix{};
+            if (m_matrix)
+                matrix = Unique() ? std::move(*m_matrix) : *m_matrix;
+            m_matrix.reset();
+            return matrix;
+        }
+
+        void Reset() { m_matrix.reset(); }
+
+    private:
+        std::shared_ptr<Matrix<T>> m_matrix{};
+    };
+}